@@ -0,0 +1,206 @@
+#include "animation.h"
+#include "model.h"
+#include "simd_math.h"
+
+#include <algorithm>
+#include <cmath>
+
+#if defined(__SSE__) || defined(_M_X64) || defined(_M_IX86)
+#include <xmmintrin.h>
+#define ANIMATION_SSE 1
+#endif
+
+using std::string;
+using std::vector;
+
+int Skeleton::Find(const string& name) const {
+	for (unsigned int i = 0; i < names.size(); i++) {
+		if (names[i] == name)
+			return (int)i;
+	}
+	return -1;
+}
+
+Skeleton Skeleton::FromScene(const aiScene* scene) {
+	Skeleton skeleton;
+
+	// pre-order walk keeps parents in front of their children
+	vector<std::pair<const aiNode*, int>> stack = { { scene->mRootNode, -1 } };
+	while (!stack.empty()) {
+		auto [node, parent] = stack.back();
+		stack.pop_back();
+
+		int index = (int)skeleton.names.size();
+		skeleton.names.push_back(node->mName.C_Str());
+		skeleton.parents.push_back(parent);
+		skeleton.bindLocal.push_back(AssimpToGlm(node->mTransformation));
+		skeleton.offsets.push_back(glm::mat4(1.0f));
+
+		for (unsigned int i = node->mNumChildren; i > 0; i--) {
+			stack.push_back({ node->mChildren[i - 1], index });
+		}
+	}
+	skeleton.globalInverse = glm::inverse(skeleton.bindLocal[0]);
+
+	for (unsigned int i = 0; i < scene->mNumMeshes; i++) {
+		const aiMesh* mesh = scene->mMeshes[i];
+		for (unsigned int j = 0; j < mesh->mNumBones; j++) {
+			int joint = skeleton.Find(mesh->mBones[j]->mName.C_Str());
+			if (joint >= 0)
+				skeleton.offsets[joint] = AssimpToGlm(mesh->mBones[j]->mOffsetMatrix);
+		}
+	}
+	return skeleton;
+}
+
+AnimationClip AnimationClip::FromAssimp(const aiAnimation* animation, const Skeleton& skeleton) {
+	AnimationClip clip;
+	clip.name = animation->mName.C_Str();
+	clip.duration = (float)animation->mDuration;
+	if (animation->mTicksPerSecond > 0.0)
+		clip.ticksPerSecond = (float)animation->mTicksPerSecond;
+	clip.tracks.resize(skeleton.JointCount());
+
+	for (unsigned int i = 0; i < animation->mNumChannels; i++) {
+		const aiNodeAnim* channel = animation->mChannels[i];
+		int joint = skeleton.Find(channel->mNodeName.C_Str());
+		if (joint < 0)
+			continue;
+
+		JointTrack& track = clip.tracks[joint];
+		for (unsigned int k = 0; k < channel->mNumPositionKeys; k++) {
+			const auto& key = channel->mPositionKeys[k];
+			track.positionTimes.push_back((float)key.mTime);
+			track.positions.push_back(glm::vec3(key.mValue.x, key.mValue.y, key.mValue.z));
+		}
+		for (unsigned int k = 0; k < channel->mNumRotationKeys; k++) {
+			const auto& key = channel->mRotationKeys[k];
+			track.rotationTimes.push_back((float)key.mTime);
+			track.rotations.push_back(glm::quat(key.mValue.w, key.mValue.x, key.mValue.y, key.mValue.z));
+		}
+		for (unsigned int k = 0; k < channel->mNumScalingKeys; k++) {
+			const auto& key = channel->mScalingKeys[k];
+			track.scaleTimes.push_back((float)key.mTime);
+			track.scales.push_back(glm::vec3(key.mValue.x, key.mValue.y, key.mValue.z));
+		}
+	}
+	return clip;
+}
+
+// index of the key at or before 'time' and the blend factor towards the next one
+static unsigned int findKey(const vector<float>& times, float time, float& factor) {
+	factor = 0.0f;
+	if (times.size() < 2)
+		return 0;
+
+	auto next = std::upper_bound(times.begin(), times.end(), time);
+	if (next == times.begin())
+		return 0;
+	if (next == times.end())
+		return (unsigned int)times.size() - 1;
+
+	unsigned int index = (unsigned int)(next - times.begin()) - 1;
+	factor = (time - times[index]) / (times[index + 1] - times[index]);
+	return index;
+}
+
+void AnimationClip::Sample(const Skeleton& skeleton, float seconds, std::span<glm::mat4> local) const {
+	float ticks = duration > 0.0f ? std::fmod(seconds * ticksPerSecond, duration) : 0.0f;
+
+	for (unsigned int joint = 0; joint < skeleton.JointCount(); joint++) {
+		const JointTrack& track = tracks[joint];
+		if (track.Empty()) {
+			local[joint] = skeleton.bindLocal[joint];
+			continue;
+		}
+
+		float factor;
+		glm::vec3 position(0.0f);
+		if (!track.positions.empty()) {
+			unsigned int k = findKey(track.positionTimes, ticks, factor);
+			position = factor > 0.0f ? glm::mix(track.positions[k], track.positions[k + 1], factor) : track.positions[k];
+		}
+		glm::quat rotation(1.0f, 0.0f, 0.0f, 0.0f);
+		if (!track.rotations.empty()) {
+			unsigned int k = findKey(track.rotationTimes, ticks, factor);
+			rotation = factor > 0.0f ? glm::slerp(track.rotations[k], track.rotations[k + 1], factor) : track.rotations[k];
+		}
+		glm::vec3 scale(1.0f);
+		if (!track.scales.empty()) {
+			unsigned int k = findKey(track.scaleTimes, ticks, factor);
+			scale = factor > 0.0f ? glm::mix(track.scales[k], track.scales[k + 1], factor) : track.scales[k];
+		}
+
+		// T * R * S without the full matrix products
+		glm::mat4 m = glm::mat4_cast(glm::normalize(rotation));
+		m[0] *= scale.x;
+		m[1] *= scale.y;
+		m[2] *= scale.z;
+		m[3] = glm::vec4(position, 1.0f);
+		local[joint] = m;
+	}
+}
+
+void ComputePalettes(const Skeleton& skeleton, std::span<const AnimationState> states, std::span<glm::mat4> palettes, JobSystem& jobs) {
+	unsigned int jointCount = skeleton.JointCount();
+
+	jobs.ParallelFor((unsigned int)states.size(), 8, [&](unsigned int begin, unsigned int end) {
+		thread_local vector<glm::mat4> local, global;
+		local.resize(jointCount);
+		global.resize(jointCount);
+
+		for (unsigned int c = begin; c < end; c++) {
+			states[c].clip->Sample(skeleton, states[c].time, local);
+
+			// the hierarchy walk is serial, the palette products then run as batches
+			for (unsigned int j = 0; j < jointCount; j++) {
+				int parent = skeleton.parents[j];
+				global[j] = parent < 0 ? local[j] : MulMat4(global[parent], local[j]);
+			}
+			std::span<glm::mat4> palette = palettes.subspan((std::size_t)c * jointCount, jointCount);
+			MulMat4(skeleton.globalInverse, global, palette);
+			MulMat4(palette, skeleton.offsets, palette);
+		}
+	});
+}
+
+void SkinVertices(std::span<const SkinnedVertex> in, std::span<const glm::mat4> palette, std::span<Vertex> out) {
+	for (std::size_t i = 0; i < in.size(); i++) {
+		const SkinnedVertex& v = in[i];
+
+		// blend the bone matrices, then transform once
+		glm::mat4 skin;
+#ifdef ANIMATION_SSE
+		__m128 c[4] = { _mm_setzero_ps(), _mm_setzero_ps(), _mm_setzero_ps(), _mm_setzero_ps() };
+		for (int b = 0; b < MAX_BONE_INFLUENCE; b++) {
+			if (v.Weights[b] == 0.0f)
+				continue;
+			const float* m = &palette[v.BoneIDs[b]][0][0];
+			__m128 w = _mm_set1_ps(v.Weights[b]);
+			for (int k = 0; k < 4; k++) {
+				c[k] = _mm_add_ps(c[k], _mm_mul_ps(_mm_loadu_ps(m + k * 4), w));
+			}
+		}
+		for (int k = 0; k < 4; k++) {
+			_mm_storeu_ps(&skin[k][0], c[k]);
+		}
+#else
+		skin = glm::mat4(0.0f);
+		for (int b = 0; b < MAX_BONE_INFLUENCE; b++) {
+			if (v.Weights[b] == 0.0f)
+				continue;
+			const glm::mat4& m = palette[v.BoneIDs[b]];
+			for (int k = 0; k < 4; k++) {
+				skin[k] += m[k] * v.Weights[b];
+			}
+		}
+#endif
+
+		glm::mat3 linear(skin);
+		Vertex& o = out[i];
+		o.Position = glm::vec3(skin * glm::vec4(v.Position, 1.0f));
+		o.Normal = glm::normalize(linear * v.Normal);
+		o.TexCoords = v.TexCoords;
+		o.Tangent = linear * v.Tangent;
+	}
+}
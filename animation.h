@@ -0,0 +1,78 @@
+#ifndef ANIMATION_H
+#define ANIMATION_H
+
+#include <assimp/scene.h>
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+#include "mesh.h"
+#include "job_system.h"
+
+#include <span>
+#include <string>
+#include <vector>
+
+const int MAX_BONE_INFLUENCE = 4;
+
+// Vertex plus up to four bone influences (attribute locations 11 and 12)
+struct SkinnedVertex {
+    glm::vec3 Position;
+    glm::vec3 Normal;
+    glm::vec2 TexCoords;
+    glm::vec3 Tangent;
+    int BoneIDs[MAX_BONE_INFLUENCE];
+    float Weights[MAX_BONE_INFLUENCE];
+};
+
+// joint hierarchy flattened so that parents always come before their children
+struct Skeleton {
+    std::vector<std::string> names;
+    std::vector<int> parents;         // -1 for the root
+    std::vector<glm::mat4> bindLocal; // node transform relative to the parent
+    std::vector<glm::mat4> offsets;   // mesh space -> bone space (inverse bind pose)
+    glm::mat4 globalInverse = glm::mat4(1.0f);
+
+    unsigned int JointCount() const { return (unsigned int)names.size(); }
+    int Find(const std::string& name) const;
+
+    static Skeleton FromScene(const aiScene* scene);
+};
+
+struct JointTrack {
+    std::vector<float> positionTimes;
+    std::vector<glm::vec3> positions;
+    std::vector<float> rotationTimes;
+    std::vector<glm::quat> rotations;
+    std::vector<float> scaleTimes;
+    std::vector<glm::vec3> scales;
+
+    bool Empty() const { return positions.empty() && rotations.empty() && scales.empty(); }
+};
+
+struct AnimationClip {
+    std::string name;
+    float duration = 0.0f; // in ticks
+    float ticksPerSecond = 25.0f;
+    std::vector<JointTrack> tracks; // one per skeleton joint, empty for joints the clip does not move
+
+    static AnimationClip FromAssimp(const aiAnimation* animation, const Skeleton& skeleton);
+
+    // local joint transforms at 'seconds' into the (looping) clip
+    void Sample(const Skeleton& skeleton, float seconds, std::span<glm::mat4> local) const;
+};
+
+// what one character is playing
+struct AnimationState {
+    const AnimationClip* clip;
+    float time; // seconds
+};
+
+// bone palettes for many characters sharing a skeleton, split across the job system.
+// palettes holds states.size() * JointCount() matrices, one block per character.
+void ComputePalettes(const Skeleton& skeleton, std::span<const AnimationState> states,
+    std::span<glm::mat4> palettes, JobSystem& jobs = JobSystem::Get());
+
+// linear-blend skinning on the CPU into the standard vertex layout
+void SkinVertices(std::span<const SkinnedVertex> in, std::span<const glm::mat4> palette, std::span<Vertex> out);
+
+#endif
@@ -0,0 +1,138 @@
+#include "auto_exposure.h"
+#include "geometry_heap.h"
+
+#include <cmath>
+#include <vector>
+
+namespace {
+	// histogram.comp's work group is HISTOGRAM_GROUP x HISTOGRAM_GROUP
+	const int HISTOGRAM_GROUP = 16;
+}
+
+AutoExposure::AutoExposure(float minLogLuminance, float maxLogLuminance)
+	: minLogLuminance(minLogLuminance), maxLogLuminance(maxLogLuminance),
+	lowPercentile(0.5f), highPercentile(0.95f), adaptationSpeed(1.5f), current(0), histogramBuffer(0),
+	logLuminanceShader("./shaders/fullscreen.vs", "./shaders/log_luminance.fs"),
+	adaptShader("./shaders/fullscreen.vs", "./shaders/adapt_exposure.fs") {
+	// 0 marks "nothing measured yet", the first average is taken as is
+	const float zero = 0.0f;
+	glGenTextures(2, luminanceTextures);
+	for (int i = 0; i < 2; i++) {
+		glBindTexture(GL_TEXTURE_2D, luminanceTextures[i]);
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_R32F, 1, 1, 0, GL_RED, GL_FLOAT, &zero);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	}
+	glBindTexture(GL_TEXTURE_2D, 0);
+	glGenVertexArrays(1, &emptyVAO);
+
+	logLuminanceShader.use();
+	logLuminanceShader.setInt("hdrBuffer", 0);
+	adaptShader.use();
+	adaptShader.setInt("logLuminance", 0);
+	adaptShader.setInt("previousLuminance", 1);
+
+	// compute shaders and storage buffers are core since 4.3
+	if (GLAD_GL_VERSION_4_3) {
+		std::vector<GLuint> bins(BINS, 0u);
+		glGenBuffers(1, &histogramBuffer);
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, histogramBuffer);
+		glBufferData(GL_SHADER_STORAGE_BUFFER, BINS * sizeof(GLuint), bins.data(), GL_DYNAMIC_COPY);
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+		histogramShader = std::make_unique<Shader>("./shaders/luminance_histogram.comp");
+		histogramShader->use();
+		histogramShader->setInt("hdrBuffer", 0);
+		averageShader = std::make_unique<Shader>("./shaders/luminance_average.comp");
+		averageShader->use();
+		averageShader->setInt("adaptedLuminance", 0);
+	}
+}
+
+RenderResource AutoExposure::AddPasses(RenderGraph& graph, RenderResource hdrColor, float deltaTime) {
+	// share of the way to the new average covered this frame, independent of the frame rate
+	float adaptation = 1.0f - std::exp(-deltaTime * adaptationSpeed);
+	float range = maxLogLuminance - minLogLuminance;
+
+	if (histogramShader) {
+		RenderResource luminance = graph.Import("adapted luminance", luminanceTextures[0], { GL_R32F, 1, 1 });
+		graph.AddPass("luminance histogram", [&](RenderGraph::Builder& builder) {
+			builder.Read(hdrColor);
+			builder.Read(luminance);
+			builder.Write(luminance);
+		}, [this, hdrColor, adaptation, range](RenderGraph& g) {
+			const RenderTextureDesc& desc = g.Desc(hdrColor);
+			glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, histogramBuffer);
+
+			histogramShader->use();
+			histogramShader->setFloat("minLogLuminance", minLogLuminance);
+			histogramShader->setFloat("inverseLogLuminanceRange", 1.0f / range);
+			glActiveTexture(GL_TEXTURE0);
+			glBindTexture(GL_TEXTURE_2D, g.Texture(hdrColor));
+			glDispatchCompute((GLuint)((desc.width + HISTOGRAM_GROUP - 1) / HISTOGRAM_GROUP),
+				(GLuint)((desc.height + HISTOGRAM_GROUP - 1) / HISTOGRAM_GROUP), 1);
+			glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+
+			// also clears the bins for the next frame
+			averageShader->use();
+			averageShader->setFloat("minLogLuminance", minLogLuminance);
+			averageShader->setFloat("logLuminanceRange", range);
+			averageShader->setFloat("lowPercentile", lowPercentile);
+			averageShader->setFloat("highPercentile", highPercentile);
+			averageShader->setFloat("adaptation", adaptation);
+			glBindImageTexture(0, luminanceTextures[0], 0, GL_FALSE, 0, GL_READ_WRITE, GL_R32F);
+			glDispatchCompute(1, 1, 1);
+			glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT | GL_TEXTURE_FETCH_BARRIER_BIT);
+		});
+		return luminance;
+	}
+
+	// the 1x1 targets are ping-ponged since the adapt pass reads last frame's value
+	RenderResource previous = graph.Import("previous luminance", luminanceTextures[current], { GL_R32F, 1, 1 });
+	current = 1 - current;
+	RenderResource luminance = graph.Import("adapted luminance", luminanceTextures[current], { GL_R32F, 1, 1 });
+
+	int levels = (int)std::log2((float)REDUCTION_SIZE) + 1;
+	RenderResource logLuminance;
+	graph.AddPass("log luminance", [&](RenderGraph::Builder& builder) {
+		builder.Read(hdrColor);
+		logLuminance = builder.Write(builder.Create("log luminance", { GL_R16F, REDUCTION_SIZE, REDUCTION_SIZE, levels }));
+	}, [this, hdrColor](RenderGraph& g) {
+		GLboolean blend = glIsEnabled(GL_BLEND);
+		glDisable(GL_BLEND);
+		logLuminanceShader.use();
+		logLuminanceShader.setFloat("minLogLuminance", minLogLuminance);
+		logLuminanceShader.setFloat("maxLogLuminance", maxLogLuminance);
+		logLuminanceShader.setVec2("targetTexelSize", 1.0f / REDUCTION_SIZE, 1.0f / REDUCTION_SIZE);
+		glActiveTexture(GL_TEXTURE0);
+		glBindTexture(GL_TEXTURE_2D, g.Texture(hdrColor));
+		GeometryHeap::BindExternal(emptyVAO);
+		glDrawArrays(GL_TRIANGLES, 0, 3);
+		if (blend)
+			glEnable(GL_BLEND);
+	});
+	graph.AddPass("adapt exposure", [&](RenderGraph::Builder& builder) {
+		builder.Read(logLuminance);
+		builder.Read(previous);
+		builder.Write(luminance);
+	}, [this, logLuminance, previous, levels, adaptation](RenderGraph& g) {
+		// the mip chain's last level is the average over the whole target
+		glActiveTexture(GL_TEXTURE0);
+		glBindTexture(GL_TEXTURE_2D, g.Texture(logLuminance));
+		glGenerateMipmap(GL_TEXTURE_2D);
+		glActiveTexture(GL_TEXTURE1);
+		glBindTexture(GL_TEXTURE_2D, g.Texture(previous));
+		glActiveTexture(GL_TEXTURE0);
+
+		GLboolean blend = glIsEnabled(GL_BLEND);
+		glDisable(GL_BLEND);
+		adaptShader.use();
+		adaptShader.setInt("topLevel", levels - 1);
+		adaptShader.setFloat("adaptation", adaptation);
+		GeometryHeap::BindExternal(emptyVAO);
+		glDrawArrays(GL_TRIANGLES, 0, 3);
+		if (blend)
+			glEnable(GL_BLEND);
+	});
+	return luminance;
+}
@@ -0,0 +1,46 @@
+#ifndef AUTO_EXPOSURE_H
+#define AUTO_EXPOSURE_H
+
+#include <glad/glad.h>
+
+#include "shader.h"
+#include "render_graph.h"
+
+#include <memory>
+
+// eye adaptation for the tone mapping pass.
+// on 4.3 contexts a compute pass bins the HDR target's log luminance into a 256-bin histogram and a
+// second one averages the bins between two percentiles, so dark corners and the lights themselves
+// don't drag the exposure around. older contexts render clamped log luminance into a small
+// target and average it through its mip chain. either way the average is blended into the
+// adapted luminance over time, which never leaves the GPU: the tone mapping pass samples it.
+class AutoExposure {
+public:
+    AutoExposure(float minLogLuminance = -10.0f, float maxLogLuminance = 6.0f);
+
+    // adds the measuring passes, returns the 1x1 R32F adapted luminance to sample when tone mapping
+    RenderResource AddPasses(RenderGraph& graph, RenderResource hdrColor, float deltaTime);
+
+    // share of the histogram's pixels ignored below and above, the compute path only
+    void SetPercentiles(float low, float high) { lowPercentile = low; highPercentile = high; }
+    // how fast the eye follows, in 1 / seconds
+    void SetAdaptationSpeed(float speed) { adaptationSpeed = speed; }
+    bool UsesCompute() const { return histogramShader != nullptr; }
+private:
+    static const int BINS = 256;
+    static const int REDUCTION_SIZE = 256;
+
+    float minLogLuminance, maxLogLuminance;
+    float lowPercentile, highPercentile;
+    float adaptationSpeed;
+
+    // last frame's and this frame's adapted luminance, the compute path updates [0] in place
+    unsigned int luminanceTextures[2];
+    int current;
+    unsigned int histogramBuffer;
+    unsigned int emptyVAO;
+    Shader logLuminanceShader, adaptShader;
+    std::unique_ptr<Shader> histogramShader, averageShader;
+};
+
+#endif
@@ -0,0 +1,100 @@
+#include "bloom.h"
+#include "geometry_heap.h"
+
+#include <algorithm>
+#include <cmath>
+
+Bloom::Bloom(int levels, float radius)
+	: levels(levels), usedLevels(levels), radius(radius), format(GL_RGBA16F), chain(NO_RESOURCE),
+	downsampleShader("./shaders/fullscreen.vs", "./shaders/bloom_downsample.fs"),
+	upsampleShader("./shaders/fullscreen.vs", "./shaders/bloom_upsample.fs") {
+	glGenVertexArrays(1, &emptyVAO);
+
+	downsampleShader.use();
+	downsampleShader.setInt("source", 0);
+	upsampleShader.use();
+	upsampleShader.setInt("source", 0);
+}
+
+RenderResource Bloom::AddPasses(RenderGraph& graph, RenderResource bright) {
+	const RenderTextureDesc& source = graph.Desc(bright);
+	int width = std::max(1, source.width / 2);
+	int height = std::max(1, source.height / 2);
+	// no level below 1x1
+	int maxLevels = (int)std::floor(std::log2((float)std::max(width, height))) + 1;
+	usedLevels = std::clamp(levels, 1, maxLevels);
+
+	graph.AddPass("bloom", [&](RenderGraph::Builder& builder) {
+		builder.Read(bright);
+		chain = builder.Write(builder.Create("bloom chain", { format, width, height, usedLevels }));
+	}, [this, bright](RenderGraph& g) {
+		int count = usedLevels;
+		const RenderTextureDesc& desc = g.Desc(chain);
+		auto texelSize = [&](int level) {
+			return glm::vec2(1.0f / std::max(1, desc.width >> level), 1.0f / std::max(1, desc.height >> level));
+		};
+
+		GLboolean depthTest = glIsEnabled(GL_DEPTH_TEST);
+		GLboolean blend = glIsEnabled(GL_BLEND);
+		GLint blendFunc[4];
+		glGetIntegerv(GL_BLEND_SRC_RGB, &blendFunc[0]);
+		glGetIntegerv(GL_BLEND_DST_RGB, &blendFunc[1]);
+		glGetIntegerv(GL_BLEND_SRC_ALPHA, &blendFunc[2]);
+		glGetIntegerv(GL_BLEND_DST_ALPHA, &blendFunc[3]);
+		glDisable(GL_DEPTH_TEST);
+		glDisable(GL_BLEND);
+		GeometryHeap::BindExternal(emptyVAO);
+		glActiveTexture(GL_TEXTURE0);
+		timer.Begin();
+
+		// level i reads level i - 1, restricted to it so the level being written is never sampled
+		downsampleShader.use();
+		for (int level = 0; level < count; level++) {
+			g.BindTargets({ chain }, NO_RESOURCE, level);
+			if (level == 0) {
+				const RenderTextureDesc& brightDesc = g.Desc(bright);
+				glBindTexture(GL_TEXTURE_2D, g.Texture(bright));
+				downsampleShader.setVec2("sourceTexelSize", 1.0f / brightDesc.width, 1.0f / brightDesc.height);
+			} else {
+				glBindTexture(GL_TEXTURE_2D, g.Texture(chain));
+				glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, level - 1);
+				glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, level - 1);
+				glm::vec2 texel = texelSize(level - 1);
+				downsampleShader.setVec2("sourceTexelSize", texel.x, texel.y);
+			}
+			glm::vec2 target = texelSize(level);
+			downsampleShader.setVec2("targetTexelSize", target.x, target.y);
+			// the first level weights its taps by luminance so single hot pixels don't flicker
+			downsampleShader.setBool("karisAverage", level == 0);
+			glDrawArrays(GL_TRIANGLES, 0, 3);
+		}
+
+		// back up the chain, each level adds the tent-filtered level below onto itself
+		glEnable(GL_BLEND);
+		glBlendFunc(GL_ONE, GL_ONE);
+		upsampleShader.use();
+		upsampleShader.setFloat("radius", radius);
+		glBindTexture(GL_TEXTURE_2D, g.Texture(chain));
+		for (int level = count - 2; level >= 0; level--) {
+			g.BindTargets({ chain }, NO_RESOURCE, level);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, level + 1);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, level + 1);
+			glm::vec2 texel = texelSize(level + 1);
+			glm::vec2 target = texelSize(level);
+			upsampleShader.setVec2("sourceTexelSize", texel.x, texel.y);
+			upsampleShader.setVec2("targetTexelSize", target.x, target.y);
+			glDrawArrays(GL_TRIANGLES, 0, 3);
+		}
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, 0);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, count - 1);
+		glBindTexture(GL_TEXTURE_2D, 0);
+		timer.End();
+
+		glBlendFuncSeparate(blendFunc[0], blendFunc[1], blendFunc[2], blendFunc[3]);
+		if (!blend)
+			glDisable(GL_BLEND);
+		if (depthTest)
+			glEnable(GL_DEPTH_TEST);
+	});
+	return chain;
+}
@@ -0,0 +1,40 @@
+#ifndef BLOOM_H
+#define BLOOM_H
+
+#include <glad/glad.h>
+
+#include "shader.h"
+#include "render_graph.h"
+#include "gpu_timer.h"
+
+// progressive bloom over a half-resolution mip chain.
+// the bright pass is filtered down level by level with a 13-tap kernel, then every level is
+// upsampled with a 3x3 tent and added onto the one above it. level 0 ends up holding the sum
+// of all blur widths, at the cost of about two fullscreen passes.
+class Bloom {
+public:
+    Bloom(int levels = 6, float radius = 1.0f);
+
+    // adds the bloom pass reading the bright-pass target, returns the chain (sample its level 0)
+    RenderResource AddPasses(RenderGraph& graph, RenderResource bright);
+
+    // tent radius of the upsample in texels of the level being read, widens the glow
+    void SetRadius(float radius) { this->radius = radius; }
+    float Radius() const { return radius; }
+    // internal format of the chain, any colour-renderable float format
+    void SetFormat(GLenum format) { this->format = format; }
+    // scale that brings the sum of the levels back to the bright pass's energy
+    float Normalization() const { return 1.0f / usedLevels; }
+    // smoothed GPU time of the bloom pass
+    double Milliseconds() const { return timer.Milliseconds(); }
+private:
+    int levels, usedLevels;
+    float radius;
+    GLenum format;
+    RenderResource chain; // of the frame being built
+    unsigned int emptyVAO;
+    Shader downsampleShader, upsampleShader;
+    GpuTimer timer;
+};
+
+#endif
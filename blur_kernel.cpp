@@ -0,0 +1,49 @@
+#include "blur_kernel.h"
+
+#include <cmath>
+
+BlurKernel BlurKernel::Gaussian(float sigma, int radius) {
+	BlurKernel kernel;
+	// no blur at all, the gaussian would divide by zero
+	if (!(sigma > 0.0f)) {
+		kernel.offsets.push_back(0.0f);
+		kernel.weights.push_back(1.0f);
+		return kernel;
+	}
+	if (radius <= 0)
+		radius = (int)std::ceil(3.0f * sigma);
+
+	float total = 0.0f;
+	for (int i = 0; i <= radius; i++) {
+		float weight = std::exp(-(float)(i * i) / (2.0f * sigma * sigma));
+		kernel.offsets.push_back((float)i);
+		kernel.weights.push_back(weight);
+		total += i == 0 ? weight : 2.0f * weight;
+	}
+	// the truncated tails are spread over the rest so the blur keeps the image's energy
+	for (float& weight : kernel.weights)
+		weight /= total;
+	return kernel;
+}
+
+BlurKernel BlurKernel::FoldBilinear(const BlurKernel& discrete) {
+	BlurKernel folded;
+	folded.offsets.push_back(discrete.offsets[0]);
+	folded.weights.push_back(discrete.weights[0]);
+	std::size_t i = 1;
+	for (; i + 1 < discrete.weights.size(); i += 2) {
+		float w0 = discrete.weights[i], w1 = discrete.weights[i + 1];
+		float weight = w0 + w1;
+		// far tails of a narrow kernel underflow, the offset of an empty pair would be NaN
+		if (weight == 0.0f)
+			continue;
+		folded.offsets.push_back((discrete.offsets[i] * w0 + discrete.offsets[i + 1] * w1) / weight);
+		folded.weights.push_back(weight);
+	}
+	// an odd tap at the end stays a point sample
+	if (i < discrete.weights.size() && discrete.weights[i] > 0.0f) {
+		folded.offsets.push_back(discrete.offsets[i]);
+		folded.weights.push_back(discrete.weights[i]);
+	}
+	return folded;
+}
@@ -0,0 +1,20 @@
+#ifndef BLUR_KERNEL_H
+#define BLUR_KERNEL_H
+
+#include <vector>
+
+// one half of a symmetric 1D kernel, tap 0 is the centre and every other tap is used mirrored too
+struct BlurKernel {
+    std::vector<float> offsets; // in texels
+    std::vector<float> weights;
+
+    // normalised gaussian sampled at the integer offsets 0..radius, a radius of 0 picks ceil(3 sigma).
+    // a sigma of 0 or less is the identity, the centre tap alone
+    static BlurKernel Gaussian(float sigma, int radius = 0);
+    // merges neighbouring taps i, i + 1 into one bilinear fetch between them weighted so the
+    // filtered value equals the two point samples, roughly halving the fetches. pairs whose weights
+    // underflowed to 0 are dropped
+    static BlurKernel FoldBilinear(const BlurKernel& discrete);
+};
+
+#endif
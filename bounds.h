@@ -0,0 +1,102 @@
+#ifndef BOUNDS_H
+#define BOUNDS_H
+
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <cmath>
+
+struct AABB {
+    glm::vec3 min = glm::vec3(0.0f);
+    glm::vec3 max = glm::vec3(0.0f);
+
+    glm::vec3 Center() const { return (min + max) * 0.5f; }
+    glm::vec3 Extent() const { return (max - min) * 0.5f; }
+    float SurfaceArea() const {
+        glm::vec3 d = max - min;
+        return 2.0f * (d.x * d.y + d.y * d.z + d.z * d.x);
+    }
+    bool Contains(const AABB& other) const {
+        return min.x <= other.min.x && min.y <= other.min.y && min.z <= other.min.z
+            && other.max.x <= max.x && other.max.y <= max.y && other.max.z <= max.z;
+    }
+    bool Overlaps(const AABB& other) const {
+        return min.x <= other.max.x && other.min.x <= max.x
+            && min.y <= other.max.y && other.min.y <= max.y
+            && min.z <= other.max.z && other.min.z <= max.z;
+    }
+
+    static AABB Union(const AABB& a, const AABB& b) {
+        return { glm::min(a.min, b.min), glm::max(a.max, b.max) };
+    }
+    // box enclosing 'box' after an affine transform
+    static AABB Transform(const AABB& box, const glm::mat4& m) {
+        glm::vec3 center = glm::vec3(m * glm::vec4(box.Center(), 1.0f));
+        glm::vec3 extent = glm::abs(glm::vec3(m[0])) * box.Extent().x
+            + glm::abs(glm::vec3(m[1])) * box.Extent().y
+            + glm::abs(glm::vec3(m[2])) * box.Extent().z;
+        return { center - extent, center + extent };
+    }
+};
+
+enum class Containment {
+    Outside,
+    Intersects,
+    Inside,
+};
+
+// six planes pointing inwards, xyz normal and w distance
+struct Frustum {
+    glm::vec4 planes[6];
+
+    // Gribb/Hartmann extraction from a view-projection matrix
+    static Frustum FromMatrix(const glm::mat4& m) {
+        glm::vec4 rows[4];
+        for (int i = 0; i < 4; i++)
+            rows[i] = glm::vec4(m[0][i], m[1][i], m[2][i], m[3][i]);
+
+        Frustum frustum;
+        for (int i = 0; i < 3; i++) {
+            frustum.planes[i * 2] = rows[3] + rows[i];
+            frustum.planes[i * 2 + 1] = rows[3] - rows[i];
+        }
+        for (auto& plane : frustum.planes)
+            plane /= glm::length(glm::vec3(plane));
+        return frustum;
+    }
+
+    Containment Test(const AABB& box) const {
+        glm::vec3 center = box.Center();
+        glm::vec3 extent = box.Extent();
+        Containment result = Containment::Inside;
+        for (const auto& plane : planes) {
+            glm::vec3 normal(plane);
+            float distance = glm::dot(normal, center) + plane.w;
+            float radius = glm::dot(glm::abs(normal), extent);
+            if (distance < -radius)
+                return Containment::Outside;
+            if (distance < radius)
+                result = Containment::Intersects;
+        }
+        return result;
+    }
+};
+
+inline bool SphereOverlaps(const glm::vec3& center, float radius, const AABB& box) {
+    glm::vec3 closest = glm::clamp(center, box.min, box.max);
+    glm::vec3 d = closest - center;
+    return glm::dot(d, d) <= radius * radius;
+}
+
+// slab test, invDirection = 1 / direction. returns the entry distance or -1 on a miss
+inline float RayIntersects(const glm::vec3& origin, const glm::vec3& invDirection, float maxDistance, const AABB& box) {
+    glm::vec3 t0 = (box.min - origin) * invDirection;
+    glm::vec3 t1 = (box.max - origin) * invDirection;
+    glm::vec3 tNear = glm::min(t0, t1);
+    glm::vec3 tFar = glm::max(t0, t1);
+    float enter = std::max(std::max(tNear.x, tNear.y), std::max(tNear.z, 0.0f));
+    float exit = std::min(std::min(tFar.x, tFar.y), std::min(tFar.z, maxDistance));
+    return enter <= exit ? enter : -1.0f;
+}
+
+#endif
@@ -0,0 +1,311 @@
+#include "bvh.h"
+
+#include <algorithm>
+#include <cmath>
+#include <utility>
+
+Bvh::Bvh(float margin) : root(NONE), freeList(NONE), leafCount(0), margin(margin) {
+}
+
+int Bvh::allocateNode() {
+	if (freeList == NONE) {
+		nodes.emplace_back();
+		return (int)nodes.size() - 1;
+	}
+	int node = freeList;
+	freeList = nodes[node].parent;
+	nodes[node] = Node();
+	return node;
+}
+
+void Bvh::freeNode(int node) {
+	nodes[node].parent = freeList;
+	nodes[node].height = -1;
+	freeList = node;
+}
+
+int Bvh::Insert(const AABB& box, unsigned int userData) {
+	int proxy = allocateNode();
+	glm::vec3 r(margin);
+	nodes[proxy].box = { box.min - r, box.max + r };
+	nodes[proxy].userData = userData;
+	nodes[proxy].height = 0;
+	insertLeaf(proxy);
+	leafCount++;
+	return proxy;
+}
+
+void Bvh::Remove(int proxy) {
+	removeLeaf(proxy);
+	freeNode(proxy);
+	leafCount--;
+}
+
+bool Bvh::Move(int proxy, const AABB& box) {
+	if (nodes[proxy].box.Contains(box))
+		return false;
+
+	removeLeaf(proxy);
+	glm::vec3 r(margin);
+	nodes[proxy].box = { box.min - r, box.max + r };
+	insertLeaf(proxy);
+	return true;
+}
+
+void Bvh::Refit(int proxy, const AABB& box) {
+	glm::vec3 r(margin);
+	nodes[proxy].box = { box.min - r, box.max + r };
+	for (int node = nodes[proxy].parent; node != NONE; node = nodes[node].parent)
+		nodes[node].box = AABB::Union(nodes[nodes[node].child1].box, nodes[nodes[node].child2].box);
+}
+
+void Bvh::insertLeaf(int leaf) {
+	if (root == NONE) {
+		root = leaf;
+		nodes[root].parent = NONE;
+		return;
+	}
+
+	// descend towards the sibling with the lowest surface area cost
+	AABB leafBox = nodes[leaf].box;
+	int index = root;
+	while (!nodes[index].IsLeaf()) {
+		const Node& node = nodes[index];
+		float area = node.box.SurfaceArea();
+		float combinedArea = AABB::Union(node.box, leafBox).SurfaceArea();
+
+		// cost of making a new parent for this node and the leaf
+		float cost = 2.0f * combinedArea;
+		// minimum cost of pushing the leaf further down
+		float inheritanceCost = 2.0f * (combinedArea - area);
+
+		float childCosts[2];
+		int children[2] = { node.child1, node.child2 };
+		for (int i = 0; i < 2; i++) {
+			const Node& child = nodes[children[i]];
+			float unionArea = AABB::Union(leafBox, child.box).SurfaceArea();
+			childCosts[i] = child.IsLeaf() ? unionArea + inheritanceCost
+				: unionArea - child.box.SurfaceArea() + inheritanceCost;
+		}
+
+		if (cost < childCosts[0] && cost < childCosts[1])
+			break;
+		index = childCosts[0] < childCosts[1] ? children[0] : children[1];
+	}
+
+	int sibling = index;
+	int oldParent = nodes[sibling].parent;
+	int newParent = allocateNode();
+	nodes[newParent].parent = oldParent;
+	nodes[newParent].box = AABB::Union(leafBox, nodes[sibling].box);
+	nodes[newParent].height = nodes[sibling].height + 1;
+	nodes[newParent].child1 = sibling;
+	nodes[newParent].child2 = leaf;
+	nodes[sibling].parent = newParent;
+	nodes[leaf].parent = newParent;
+
+	if (oldParent == NONE) {
+		root = newParent;
+	} else if (nodes[oldParent].child1 == sibling) {
+		nodes[oldParent].child1 = newParent;
+	} else {
+		nodes[oldParent].child2 = newParent;
+	}
+
+	fixUpwards(nodes[leaf].parent);
+}
+
+void Bvh::removeLeaf(int leaf) {
+	if (leaf == root) {
+		root = NONE;
+		return;
+	}
+
+	int parent = nodes[leaf].parent;
+	int grandParent = nodes[parent].parent;
+	int sibling = nodes[parent].child1 == leaf ? nodes[parent].child2 : nodes[parent].child1;
+
+	// the sibling takes the parent's place
+	if (grandParent == NONE) {
+		root = sibling;
+		nodes[sibling].parent = NONE;
+		freeNode(parent);
+		return;
+	}
+	if (nodes[grandParent].child1 == parent)
+		nodes[grandParent].child1 = sibling;
+	else
+		nodes[grandParent].child2 = sibling;
+	nodes[sibling].parent = grandParent;
+	freeNode(parent);
+
+	fixUpwards(grandParent);
+}
+
+void Bvh::fixUpwards(int node) {
+	while (node != NONE) {
+		node = balance(node);
+
+		Node& n = nodes[node];
+		n.height = 1 + std::max(nodes[n.child1].height, nodes[n.child2].height);
+		n.box = AABB::Union(nodes[n.child1].box, nodes[n.child2].box);
+		node = n.parent;
+	}
+}
+
+// rotates the taller child up when the subtree leans by more than one level,
+// returns the node now at the top of the subtree
+int Bvh::balance(int a) {
+	if (nodes[a].IsLeaf() || nodes[a].height < 2)
+		return a;
+
+	int b = nodes[a].child1;
+	int c = nodes[a].child2;
+	int lean = nodes[c].height - nodes[b].height;
+	if (lean >= -1 && lean <= 1)
+		return a;
+
+	// 'up' is the taller child, it replaces a; 'other' stays below a
+	int up = lean > 1 ? c : b;
+	int f = nodes[up].child1;
+	int g = nodes[up].child2;
+
+	nodes[up].child1 = a;
+	nodes[up].parent = nodes[a].parent;
+	nodes[a].parent = up;
+
+	int upParent = nodes[up].parent;
+	if (upParent == NONE) {
+		root = up;
+	} else if (nodes[upParent].child1 == a) {
+		nodes[upParent].child1 = up;
+	} else {
+		nodes[upParent].child2 = up;
+	}
+
+	// the taller grandchild stays with 'up', the shorter one moves under a
+	int keep = nodes[f].height > nodes[g].height ? f : g;
+	int move = keep == f ? g : f;
+	nodes[up].child2 = keep;
+	if (up == c)
+		nodes[a].child2 = move;
+	else
+		nodes[a].child1 = move;
+	nodes[move].parent = a;
+
+	Node& na = nodes[a];
+	na.box = AABB::Union(nodes[na.child1].box, nodes[na.child2].box);
+	na.height = 1 + std::max(nodes[na.child1].height, nodes[na.child2].height);
+	Node& nu = nodes[up];
+	nu.box = AABB::Union(na.box, nodes[keep].box);
+	nu.height = 1 + std::max(na.height, nodes[keep].height);
+	return up;
+}
+
+void Bvh::collectLeaves(int node, std::vector<unsigned int>& results) const {
+	std::size_t base = stack.size();
+	stack.push_back(node);
+	while (stack.size() > base) {
+		int index = stack.back();
+		stack.pop_back();
+		const Node& n = nodes[index];
+		if (n.IsLeaf()) {
+			results.push_back(n.userData);
+		} else {
+			stack.push_back(n.child1);
+			stack.push_back(n.child2);
+		}
+	}
+}
+
+void Bvh::QueryFrustum(const Frustum& frustum, std::vector<unsigned int>& results) const {
+	if (root == NONE)
+		return;
+
+	stack.clear();
+	stack.push_back(root);
+	while (!stack.empty()) {
+		int index = stack.back();
+		stack.pop_back();
+		const Node& n = nodes[index];
+
+		Containment containment = frustum.Test(n.box);
+		if (containment == Containment::Outside)
+			continue;
+		// whole subtree visible, no more plane tests below here
+		if (containment == Containment::Inside || n.IsLeaf()) {
+			collectLeaves(index, results);
+			continue;
+		}
+		stack.push_back(n.child1);
+		stack.push_back(n.child2);
+	}
+}
+
+void Bvh::QuerySphere(const glm::vec3& center, float radius, std::vector<unsigned int>& results) const {
+	if (root == NONE)
+		return;
+
+	stack.clear();
+	stack.push_back(root);
+	while (!stack.empty()) {
+		const Node& n = nodes[stack.back()];
+		stack.pop_back();
+		if (!SphereOverlaps(center, radius, n.box))
+			continue;
+		if (n.IsLeaf()) {
+			results.push_back(n.userData);
+		} else {
+			stack.push_back(n.child1);
+			stack.push_back(n.child2);
+		}
+	}
+}
+
+void Bvh::QueryAABB(const AABB& box, std::vector<unsigned int>& results) const {
+	if (root == NONE)
+		return;
+
+	stack.clear();
+	stack.push_back(root);
+	while (!stack.empty()) {
+		const Node& n = nodes[stack.back()];
+		stack.pop_back();
+		if (!n.box.Overlaps(box))
+			continue;
+		if (n.IsLeaf()) {
+			results.push_back(n.userData);
+		} else {
+			stack.push_back(n.child1);
+			stack.push_back(n.child2);
+		}
+	}
+}
+
+void Bvh::QueryRay(const glm::vec3& origin, const glm::vec3& direction, float maxDistance, std::vector<unsigned int>& results) const {
+	if (root == NONE)
+		return;
+
+	glm::vec3 invDirection = 1.0f / direction;
+	std::vector<std::pair<float, unsigned int>> hits;
+
+	stack.clear();
+	stack.push_back(root);
+	while (!stack.empty()) {
+		const Node& n = nodes[stack.back()];
+		stack.pop_back();
+		float distance = RayIntersects(origin, invDirection, maxDistance, n.box);
+		if (distance < 0.0f)
+			continue;
+		if (n.IsLeaf()) {
+			hits.push_back({ distance, n.userData });
+		} else {
+			stack.push_back(n.child1);
+			stack.push_back(n.child2);
+		}
+	}
+
+	std::sort(hits.begin(), hits.end());
+	for (const auto& hit : hits)
+		results.push_back(hit.second);
+}
@@ -0,0 +1,69 @@
+#ifndef BVH_H
+#define BVH_H
+
+#include <glm/glm.hpp>
+
+#include "bounds.h"
+
+#include <vector>
+
+// dynamic bounding volume hierarchy over object bounds.
+// leaves store boxes enlarged by a margin so small movements do not touch the tree;
+// inserts pick the sibling with the lowest surface area cost and rotations keep it balanced.
+class Bvh {
+public:
+    static const int NONE = -1;
+
+    Bvh(float margin = 0.1f);
+
+    // returns a proxy id for the object, userData comes back from queries
+    int Insert(const AABB& box, unsigned int userData);
+    void Remove(int proxy);
+    // re-inserts the proxy when 'box' left its enlarged bounds, returns true if it did
+    bool Move(int proxy, const AABB& box);
+    // replaces the leaf box and refits its ancestors in place, cheaper than Move
+    // but the tree is not restructured, so heavy use degrades query cost
+    void Refit(int proxy, const AABB& box);
+
+    unsigned int UserData(int proxy) const { return nodes[proxy].userData; }
+    const AABB& FatBounds(int proxy) const { return nodes[proxy].box; }
+
+    // queries append the userData of every leaf whose enlarged box passes the test
+    void QueryFrustum(const Frustum& frustum, std::vector<unsigned int>& results) const;
+    void QuerySphere(const glm::vec3& center, float radius, std::vector<unsigned int>& results) const;
+    void QueryAABB(const AABB& box, std::vector<unsigned int>& results) const;
+    // leaves hit by the ray within maxDistance, nearest entry first
+    void QueryRay(const glm::vec3& origin, const glm::vec3& direction, float maxDistance, std::vector<unsigned int>& results) const;
+
+    int Height() const { return root == NONE ? 0 : nodes[root].height; }
+    unsigned int LeafCount() const { return leafCount; }
+private:
+    struct Node {
+        AABB box;
+        int parent = NONE; // doubles as the free-list link
+        int child1 = NONE;
+        int child2 = NONE;
+        int height = -1;   // 0 for leaves, -1 for free nodes
+        unsigned int userData = 0;
+
+        bool IsLeaf() const { return child1 == NONE; }
+    };
+
+    std::vector<Node> nodes;
+    int root;
+    int freeList;
+    unsigned int leafCount;
+    float margin;
+    mutable std::vector<int> stack; // query traversal stack
+
+    int allocateNode();
+    void freeNode(int node);
+    void insertLeaf(int leaf);
+    void removeLeaf(int leaf);
+    // refits and rebalances from 'node' up to the root
+    void fixUpwards(int node);
+    int balance(int node);
+    void collectLeaves(int node, std::vector<unsigned int>& results) const;
+};
+
+#endif
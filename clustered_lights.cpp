@@ -0,0 +1,149 @@
+#include "clustered_lights.h"
+
+#include <algorithm>
+#include <cmath>
+
+ClusteredLights::ClusteredLights(int tilesX, int tilesY, int slices)
+	: tilesX(tilesX), tilesY(tilesY), slices(slices), nearPlane(0.1f), farPlane(100.0f),
+	projection(0.0f), lightCount(0) {
+	// light data (RGBA32F), grid (RG32UI) and indices (R32UI), never left without storage
+	const GLenum formats[3] = { GL_RGBA32F, GL_RG32UI, GL_R32UI };
+	glGenBuffers(3, buffers);
+	glGenTextures(3, textures);
+	for (int i = 0; i < 3; i++) {
+		capacities[i] = 16;
+		glBindBuffer(GL_TEXTURE_BUFFER, buffers[i]);
+		glBufferData(GL_TEXTURE_BUFFER, capacities[i], NULL, GL_STREAM_DRAW);
+		glBindTexture(GL_TEXTURE_BUFFER, textures[i]);
+		glTexBuffer(GL_TEXTURE_BUFFER, formats[i], buffers[i]);
+	}
+	glBindTexture(GL_TEXTURE_BUFFER, 0);
+	glBindBuffer(GL_TEXTURE_BUFFER, 0);
+	grid.assign((std::size_t)ClusterCount() * 2, 0);
+}
+
+// near and far come back out of a glm::perspective matrix, the tiles assume a symmetric frustum
+void ClusteredLights::buildClusters() {
+	nearPlane = projection[3][2] / (projection[2][2] - 1.0f);
+	farPlane = projection[3][2] / (projection[2][2] + 1.0f);
+	float tanX = 1.0f / projection[0][0];
+	float tanY = 1.0f / projection[1][1];
+
+	clusterBounds.Resize((std::size_t)ClusterCount());
+	std::size_t cluster = 0;
+	for (int s = 0; s < slices; s++) {
+		float d0 = nearPlane * std::pow(farPlane / nearPlane, (float)s / slices);
+		float d1 = nearPlane * std::pow(farPlane / nearPlane, (float)(s + 1) / slices);
+		for (int y = 0; y < tilesY; y++) {
+			float y0 = (-1.0f + 2.0f * y / tilesY) * tanY;
+			float y1 = (-1.0f + 2.0f * (y + 1) / tilesY) * tanY;
+			for (int x = 0; x < tilesX; x++) {
+				float x0 = (-1.0f + 2.0f * x / tilesX) * tanX;
+				float x1 = (-1.0f + 2.0f * (x + 1) / tilesX) * tanX;
+				// the tile's side planes meet at the eye, so the box spans both depth ends
+				glm::vec3 min(std::min(x0 * d0, x0 * d1), std::min(y0 * d0, y0 * d1), -d1);
+				glm::vec3 max(std::max(x1 * d0, x1 * d1), std::max(y1 * d0, y1 * d1), -d0);
+				clusterBounds.Set(cluster++, min, max);
+			}
+		}
+	}
+}
+
+int ClusteredLights::slice(float depth) const {
+	if (depth <= nearPlane)
+		return 0;
+	int s = (int)(std::log(depth / nearPlane) * slices / std::log(farPlane / nearPlane));
+	return std::clamp(s, 0, slices - 1);
+}
+
+void ClusteredLights::Update(const glm::mat4& view, const glm::mat4& projection, std::span<const PointLight> lights) {
+	if (projection != this->projection) {
+		this->projection = projection;
+		buildClusters();
+	}
+
+	lightCount = (unsigned int)lights.size();
+	lightData.resize((std::size_t)lightCount * 2);
+	pairs.clear();
+
+	// a light only visits the slices and rows its bounds cover, those rows are one contiguous run of boxes
+	float yScale = projection[1][1]; // ndc y = view y / depth * yScale
+	std::size_t perSlice = (std::size_t)tilesX * tilesY;
+	hits.resize(perSlice);
+	for (unsigned int i = 0; i < lightCount; i++) {
+		const PointLight& light = lights[i];
+		lightData[2 * i] = glm::vec4(light.position, light.radius);
+		lightData[2 * i + 1] = glm::vec4(light.color, 0.0f);
+
+		glm::vec3 center = glm::vec3(view * glm::vec4(light.position, 1.0f));
+		float depth = -center.z;
+		if (depth + light.radius < nearPlane || depth - light.radius > farPlane)
+			continue;
+
+		// tile rows the sphere's bounding box can project to, y / depth is monotonic in depth
+		float nearest = std::max(depth - light.radius, nearPlane);
+		float farthest = depth + light.radius;
+		float bottom = std::min((center.y - light.radius) / nearest, (center.y - light.radius) / farthest) * yScale;
+		float top = std::max((center.y + light.radius) / nearest, (center.y + light.radius) / farthest) * yScale;
+		int row0 = std::clamp((int)std::floor((bottom + 1.0f) * 0.5f * tilesY), 0, tilesY - 1);
+		int row1 = std::clamp((int)std::floor((top + 1.0f) * 0.5f * tilesY), 0, tilesY - 1);
+		std::size_t rows = (std::size_t)(row1 - row0 + 1) * tilesX;
+
+		int last = slice(farthest);
+		for (int s = slice(depth - light.radius); s <= last; s++) {
+			std::size_t first = (std::size_t)s * perSlice + (std::size_t)row0 * tilesX;
+			SphereOverlapsAABBs(clusterBounds, first, center, light.radius, std::span<uint8_t>(hits.data(), rows));
+			for (std::size_t c = 0; c < rows; c++) {
+				if (!hits[c])
+					continue;
+				pairs.push_back((uint32_t)(first + c));
+				pairs.push_back(i);
+			}
+		}
+	}
+
+	// counting sort of the pairs by cluster: grid[2c] first ends up at the end of the cluster's
+	// range and is walked back while filling, so it finishes at the start
+	std::fill(grid.begin(), grid.end(), 0u);
+	for (std::size_t p = 0; p < pairs.size(); p += 2)
+		grid[2 * pairs[p] + 1]++;
+	uint32_t offset = 0;
+	for (std::size_t c = 0; c < grid.size(); c += 2) {
+		offset += grid[c + 1];
+		grid[c] = offset;
+	}
+	indices.resize(pairs.size() / 2);
+	for (std::size_t p = pairs.size(); p > 0; p -= 2)
+		indices[--grid[2 * pairs[p - 2]]] = pairs[p - 1];
+
+	upload(0, lightData.data(), lightData.size() * sizeof(glm::vec4));
+	upload(1, grid.data(), grid.size() * sizeof(uint32_t));
+	upload(2, indices.data(), indices.size() * sizeof(uint32_t));
+}
+
+// the texture keeps pointing at the buffer object across re-specification, so this only orphans
+void ClusteredLights::upload(int which, const void* data, std::size_t bytes) {
+	capacities[which] = std::max(capacities[which], bytes);
+	glBindBuffer(GL_TEXTURE_BUFFER, buffers[which]);
+	glBufferData(GL_TEXTURE_BUFFER, capacities[which], NULL, GL_STREAM_DRAW);
+	if (bytes > 0)
+		glBufferSubData(GL_TEXTURE_BUFFER, 0, bytes, data);
+	glBindBuffer(GL_TEXTURE_BUFFER, 0);
+}
+
+void ClusteredLights::Bind(Shader& shader, int firstUnit, int screenWidth, int screenHeight) const {
+	// the uniforms go to whichever program is current, so make it this one
+	shader.use();
+	const char* names[3] = { "lightData", "lightGrid", "lightIndices" };
+	for (int i = 0; i < 3; i++) {
+		glActiveTexture(GL_TEXTURE0 + firstUnit + i);
+		glBindTexture(GL_TEXTURE_BUFFER, textures[i]);
+		shader.setInt(names[i], firstUnit + i);
+	}
+	glActiveTexture(GL_TEXTURE0);
+
+	shader.setIVec3("clusterCount", tilesX, tilesY, slices);
+	shader.setVec2("clusterTileSize", (float)screenWidth / tilesX, (float)screenHeight / tilesY);
+	shader.setFloat("clusterNear", nearPlane);
+	shader.setFloat("clusterSliceScale", slices / std::log(farPlane / nearPlane));
+}
@@ -0,0 +1,56 @@
+#ifndef CLUSTERED_LIGHTS_H
+#define CLUSTERED_LIGHTS_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include "shader.h"
+#include "lights.h"
+#include "simd_math.h"
+
+#include <cstdint>
+#include <span>
+#include <vector>
+
+// clustered forward lighting.
+// the view frustum is split into tilesX x tilesY screen tiles and depth slices that grow
+// exponentially from the near to the far plane. every light is assigned on the CPU to the
+// clusters its sphere touches, and the per-cluster index lists go to buffer textures so a
+// fragment only loops over the lights of its own cluster.
+class ClusteredLights {
+public:
+    ClusteredLights(int tilesX = 16, int tilesY = 9, int slices = 24);
+
+    // rebuilds the cluster bounds when the projection changed, then reassigns every light
+    void Update(const glm::mat4& view, const glm::mat4& projection, std::span<const PointLight> lights);
+    // makes the shader current, binds the three buffer textures to units firstUnit.. and sets the lookup uniforms
+    void Bind(Shader& shader, int firstUnit, int screenWidth, int screenHeight) const;
+
+    int ClusterCount() const { return tilesX * tilesY * slices; }
+    unsigned int LightCount() const { return lightCount; }
+    // light references over all clusters, the shading cost compared to lights * clusters
+    unsigned int IndexCount() const { return (unsigned int)indices.size(); }
+private:
+    int tilesX, tilesY, slices;
+    float nearPlane, farPlane;
+    glm::mat4 projection; // the one clusterBounds was built for
+    AABBArray clusterBounds; // view space, x fastest then y then slice
+
+    unsigned int lightCount;
+    std::vector<glm::vec4> lightData; // position and radius, color
+    std::vector<uint32_t> grid; // first index and count per cluster
+    std::vector<uint32_t> indices;
+    // assignment scratch
+    std::vector<uint8_t> hits;
+    std::vector<uint32_t> pairs; // cluster, light
+
+    // light data, grid and index texture buffers
+    unsigned int buffers[3], textures[3];
+    std::size_t capacities[3];
+
+    void buildClusters();
+    int slice(float depth) const;
+    void upload(int which, const void* data, std::size_t bytes);
+};
+
+#endif
@@ -0,0 +1,53 @@
+#include "deferred_renderer.h"
+#include "geometry_heap.h"
+
+namespace {
+	// texture units of the G-buffer during the light pass, the cluster lists sit at 12..14
+	const int ALBEDO_UNIT = 0;
+	const int NORMAL_UNIT = 1;
+	const int DEPTH_UNIT = 2;
+	const int CLUSTER_UNIT = 12;
+}
+
+DeferredRenderer::DeferredRenderer()
+	: geometryShader("./shaders/hdr_lighting.vs", "./shaders/gbuffer.fs"),
+	lightingShader("./shaders/fullscreen.vs", "./shaders/deferred_lighting.fs") {
+	glGenVertexArrays(1, &emptyVAO);
+
+	lightingShader.use();
+	lightingShader.setInt("gAlbedo", ALBEDO_UNIT);
+	lightingShader.setInt("gNormal", NORMAL_UNIT);
+	lightingShader.setInt("gDepth", DEPTH_UNIT);
+}
+
+void DeferredRenderer::Light(const glm::mat4& view, const glm::mat4& projection, const glm::vec3& viewPos, const ClusteredLights& lights,
+	unsigned int albedoTexture, unsigned int normalTexture, unsigned int depthTexture, int width, int height) {
+	glClear(GL_COLOR_BUFFER_BIT);
+
+	GLboolean depthTest = glIsEnabled(GL_DEPTH_TEST);
+	GLboolean blend = glIsEnabled(GL_BLEND);
+	glDisable(GL_DEPTH_TEST);
+	glDisable(GL_BLEND);
+
+	lightingShader.use();
+	lightingShader.setMat4("view", view);
+	lightingShader.setMat4("inverseViewProjection", glm::inverse(projection * view));
+	lightingShader.setVec3("viewPos", viewPos);
+	lights.Bind(lightingShader, CLUSTER_UNIT, width, height);
+
+	glActiveTexture(GL_TEXTURE0 + ALBEDO_UNIT);
+	glBindTexture(GL_TEXTURE_2D, albedoTexture);
+	glActiveTexture(GL_TEXTURE0 + NORMAL_UNIT);
+	glBindTexture(GL_TEXTURE_2D, normalTexture);
+	glActiveTexture(GL_TEXTURE0 + DEPTH_UNIT);
+	glBindTexture(GL_TEXTURE_2D, depthTexture);
+	glActiveTexture(GL_TEXTURE0);
+
+	GeometryHeap::BindExternal(emptyVAO);
+	glDrawArrays(GL_TRIANGLES, 0, 3);
+
+	if (depthTest)
+		glEnable(GL_DEPTH_TEST);
+	if (blend)
+		glEnable(GL_BLEND);
+}
@@ -0,0 +1,35 @@
+#ifndef DEFERRED_RENDERER_H
+#define DEFERRED_RENDERER_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include "shader.h"
+#include "clustered_lights.h"
+
+// deferred alternative to the forward HDR lighting shader.
+// the geometry pass writes albedo and an octahedral-encoded normal next to the scene depth texture,
+// then one fullscreen pass shades each covered pixel with the lights of its cluster. it writes the same
+// colour and bright-pass outputs as hdr_lighting.fs, so bloom and tone mapping stay unchanged.
+// the targets belong to the caller (the render graph), this only holds the programs.
+class DeferredRenderer {
+public:
+    // G-buffer formats, colour attachments 0 and 1 of the geometry pass
+    static const GLenum ALBEDO_FORMAT = GL_RGBA8;
+    static const GLenum NORMAL_FORMAT = GL_RG16F;
+
+    DeferredRenderer();
+
+    // program the scene is drawn with during the geometry pass, takes the same uniforms as hdr_lighting.vs
+    Shader& GeometryShader() { return geometryShader; }
+
+    // clears the bound colour and bright-pass targets with the current clear colour and shades every
+    // pixel the geometry pass covered
+    void Light(const glm::mat4& view, const glm::mat4& projection, const glm::vec3& viewPos, const ClusteredLights& lights,
+        unsigned int albedoTexture, unsigned int normalTexture, unsigned int depthTexture, int width, int height);
+private:
+    unsigned int emptyVAO;
+    Shader geometryShader, lightingShader;
+};
+
+#endif
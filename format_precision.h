@@ -0,0 +1,40 @@
+#ifndef FORMAT_PRECISION_H
+#define FORMAT_PRECISION_H
+
+#include <glad/glad.h>
+
+#include <cmath>
+
+// what RenderGraph::Supports expects to read back from a float render target. no GL calls in
+// here, so the tests can hold the bounds against the formats' bit layouts.
+
+// cleared and read back: above 1, well below 1 and in between, all inside every float format's normal range
+const float FORMAT_PROBE_VALUES[4] = { 64.0f, 0.5f, 0.002f, 1.0f };
+
+// largest relative error a round trip through the format may show, 0 if it isn't checked
+inline float RelativePrecision(GLenum internalFormat) {
+    switch (internalFormat) {
+    case GL_R11F_G11F_B10F:
+        return 1.0f / 32.0f; // 5-bit mantissa in blue
+    case GL_R16F: case GL_RG16F: case GL_RGB16F: case GL_RGBA16F:
+        return 1.0f / 1024.0f;
+    case GL_R32F: case GL_RG32F: case GL_RGB32F: case GL_RGBA32F:
+        return 1e-6f;
+    default:
+        return 0.0f;
+    }
+}
+
+// whether the first channelCount channels read back from a target cleared to FORMAT_PROBE_VALUES
+// are within the format's precision. formats RelativePrecision doesn't know always pass
+inline bool ProbeReadbackMatches(GLenum internalFormat, const float* pixel, int channelCount) {
+    float precision = RelativePrecision(internalFormat);
+    for (int c = 0; c < channelCount; c++) {
+        float reference = FORMAT_PROBE_VALUES[c];
+        if (precision > 0.0f && !(std::abs(pixel[c] - reference) <= reference * precision))
+            return false;
+    }
+    return true;
+}
+
+#endif
@@ -0,0 +1,91 @@
+#include "gaussian_blur.h"
+#include "geometry_heap.h"
+
+#include <algorithm>
+#include <cmath>
+#include <string>
+
+namespace {
+	// gaussian_blur.comp's work group size
+	const int COMPUTE_GROUP = 128;
+}
+
+GaussianBlur::GaussianBlur(float sigma)
+	: dirty(true), shader("./shaders/fullscreen.vs", "./shaders/gaussian_blur.fs") {
+	glGenVertexArrays(1, &emptyVAO);
+	shader.use();
+	shader.setInt("image", 0);
+	// compute shaders and image stores are core since 4.3
+	if (GLAD_GL_VERSION_4_3) {
+		computeShader = std::make_unique<Shader>("./shaders/gaussian_blur.comp");
+		computeShader->use();
+		computeShader->setInt("image", 0);
+		computeShader->setInt("result", 0);
+	}
+	SetSigma(sigma);
+}
+
+void GaussianBlur::SetSigma(float sigma) {
+	this->sigma = sigma;
+	int radius = std::min((int)std::ceil(3.0f * sigma), MAX_RADIUS);
+	discrete = BlurKernel::Gaussian(sigma, radius);
+	folded = BlurKernel::FoldBilinear(discrete);
+	dirty = true;
+}
+
+void GaussianBlur::uploadKernels() {
+	shader.use();
+	shader.setInt("tapCount", (int)folded.offsets.size());
+	for (std::size_t i = 0; i < folded.offsets.size(); i++) {
+		shader.setFloat("offsets[" + std::to_string(i) + "]", folded.offsets[i]);
+		shader.setFloat("weights[" + std::to_string(i) + "]", folded.weights[i]);
+	}
+	if (computeShader) {
+		computeShader->use();
+		computeShader->setInt("radius", (int)discrete.weights.size() - 1);
+		for (std::size_t i = 0; i < discrete.weights.size(); i++)
+			computeShader->setFloat("weights[" + std::to_string(i) + "]", discrete.weights[i]);
+	}
+	dirty = false;
+}
+
+void GaussianBlur::Blur(RenderGraph& graph, RenderResource source, RenderResource intermediate, RenderResource target) {
+	if (dirty)
+		uploadKernels();
+
+	if (computeShader) {
+		const RenderTextureDesc& desc = graph.Desc(target);
+		computePass(graph.Texture(source), graph.Texture(intermediate), graph.Desc(intermediate).internalFormat, desc.width, desc.height, true);
+		computePass(graph.Texture(intermediate), graph.Texture(target), graph.Desc(target).internalFormat, desc.width, desc.height, false);
+		return;
+	}
+	graph.BindTargets({ intermediate });
+	fragmentPass(graph.Texture(source), true);
+	graph.BindTargets({ target });
+	fragmentPass(graph.Texture(intermediate), false);
+}
+
+void GaussianBlur::fragmentPass(unsigned int source, bool horizontal) {
+	shader.use();
+	shader.setBool("horizontal", horizontal);
+
+	glActiveTexture(GL_TEXTURE0);
+	glBindTexture(GL_TEXTURE_2D, source);
+	GeometryHeap::BindExternal(emptyVAO);
+	glDrawArrays(GL_TRIANGLES, 0, 3);
+}
+
+// one work group per GROUP texels of a line, one row of groups per line
+void GaussianBlur::computePass(unsigned int source, unsigned int target, GLenum format, int width, int height, bool horizontal) {
+	computeShader->use();
+	computeShader->setBool("horizontal", horizontal);
+
+	glActiveTexture(GL_TEXTURE0);
+	glBindTexture(GL_TEXTURE_2D, source);
+	glBindImageTexture(0, target, 0, GL_FALSE, 0, GL_WRITE_ONLY, format);
+	int length = horizontal ? width : height;
+	int lines = horizontal ? height : width;
+	glDispatchCompute((GLuint)((length + COMPUTE_GROUP - 1) / COMPUTE_GROUP), (GLuint)lines, 1);
+	// the next pass, or whoever samples the result, reads it as a texture
+	glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT);
+}
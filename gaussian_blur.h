@@ -0,0 +1,46 @@
+#ifndef GAUSSIAN_BLUR_H
+#define GAUSSIAN_BLUR_H
+
+#include <glad/glad.h>
+
+#include "blur_kernel.h"
+#include "shader.h"
+#include "render_graph.h"
+
+#include <memory>
+
+// separable gaussian blur with its kernel built on the CPU.
+// on 4.3 contexts both directions run as compute dispatches that stage each line segment and its
+// apron in shared memory and imageStore the result, with no framebuffer in between. older contexts
+// draw two fullscreen passes with the kernel folded into bilinear taps. either way the taps are
+// uniform tables, so any sigma up to MAX_RADIUS runs the same programs.
+class GaussianBlur {
+public:
+    static const int MAX_TAPS = 16; // folded, per side including the centre
+    static const int MAX_RADIUS = 2 * (MAX_TAPS - 1);
+
+    GaussianBlur(float sigma);
+
+    // widens or narrows the blur, the radius is capped to MAX_RADIUS
+    void SetSigma(float sigma);
+    float Sigma() const { return sigma; }
+    bool UsesCompute() const { return computeShader != nullptr; }
+
+    // blurs source horizontally into intermediate and that vertically into target, all of one size.
+    // the compute path stores to intermediate and target as images, so their formats must be image
+    // formats too (GL_RGBA16F and GL_R11F_G11F_B10F are).
+    void Blur(RenderGraph& graph, RenderResource source, RenderResource intermediate, RenderResource target);
+private:
+    float sigma;
+    BlurKernel discrete, folded;
+    bool dirty; // taps not uploaded yet
+    unsigned int emptyVAO;
+    Shader shader;
+    std::unique_ptr<Shader> computeShader;
+
+    void uploadKernels();
+    void fragmentPass(unsigned int source, bool horizontal);
+    void computePass(unsigned int source, unsigned int target, GLenum format, int width, int height, bool horizontal);
+};
+
+#endif
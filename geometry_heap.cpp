@@ -0,0 +1,246 @@
+#include "geometry_heap.h"
+
+#include <algorithm>
+#include <iterator>
+#include <utility>
+
+unsigned int GeometryHeap::boundVAO = 0;
+
+RangeAllocator::RangeAllocator(unsigned int capacity) : capacity(capacity), used(0) {
+	if (capacity > 0)
+		freeRanges[0] = capacity;
+}
+
+unsigned int RangeAllocator::Allocate(unsigned int count) {
+	if (count == 0)
+		return INVALID;
+
+	for (auto it = freeRanges.begin(); it != freeRanges.end(); ++it) {
+		if (it->second < count)
+			continue;
+
+		unsigned int offset = it->first;
+		unsigned int remaining = it->second - count;
+		freeRanges.erase(it);
+		if (remaining > 0)
+			freeRanges[offset + count] = remaining;
+
+		used += count;
+		return offset;
+	}
+	return INVALID;
+}
+
+void RangeAllocator::Free(unsigned int offset, unsigned int count) {
+	if (count == 0)
+		return;
+	used -= count;
+
+	auto next = freeRanges.lower_bound(offset);
+	// merge with the following free range
+	if (next != freeRanges.end() && offset + count == next->first) {
+		count += next->second;
+		next = freeRanges.erase(next);
+	}
+	// merge with the preceding free range
+	if (next != freeRanges.begin()) {
+		auto prev = std::prev(next);
+		if (prev->first + prev->second == offset) {
+			prev->second += count;
+			return;
+		}
+	}
+	freeRanges[offset] = count;
+}
+
+void RangeAllocator::Grow(unsigned int newCapacity) {
+	if (newCapacity <= capacity)
+		return;
+
+	unsigned int oldCapacity = capacity;
+	capacity = newCapacity;
+	// Free() expects the block to have been counted as used
+	used += newCapacity - oldCapacity;
+	Free(oldCapacity, newCapacity - oldCapacity);
+}
+
+GeometryHeap::GeometryHeap(VertexFormat format, unsigned int vertexCapacity, unsigned int indexCapacity,
+	unsigned int instanceBuffer, VertexFormat instanceFormat)
+	: format(std::move(format)), instanceFormat(std::move(instanceFormat)),
+	vertexAllocator(vertexCapacity), indexAllocator(indexCapacity), instanceBuffer(instanceBuffer), instanceOffset(0) {
+	glGenVertexArrays(1, &VAO);
+	glGenBuffers(1, &VBO);
+	glGenBuffers(1, &EBO);
+
+	// upload through the copy targets so the currently bound VAO's element buffer is left alone
+	glBindBuffer(GL_COPY_WRITE_BUFFER, VBO);
+	glBufferData(GL_COPY_WRITE_BUFFER, (GLsizeiptr)vertexCapacity * this->format.stride, NULL, GL_STATIC_DRAW);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, EBO);
+	glBufferData(GL_COPY_WRITE_BUFFER, (GLsizeiptr)indexCapacity * sizeof(unsigned int), NULL, GL_STATIC_DRAW);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+
+	setupVAO();
+}
+
+void GeometryHeap::setupVAO() {
+	glBindVertexArray(VAO);
+	boundVAO = VAO;
+
+	glBindBuffer(GL_ARRAY_BUFFER, VBO);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+	for (const auto& attribute : format.attributes) {
+		glEnableVertexAttribArray(attribute.index);
+		if (attribute.integer)
+			glVertexAttribIPointer(attribute.index, attribute.size, attribute.type, format.stride, (void*)attribute.offset);
+		else
+			glVertexAttribPointer(attribute.index, attribute.size, attribute.type, GL_FALSE, format.stride, (void*)attribute.offset);
+	}
+
+	if (instanceBuffer) {
+		for (const auto& attribute : instanceFormat.attributes) {
+			glEnableVertexAttribArray(attribute.index);
+			glVertexAttribDivisor(attribute.index, 1);
+		}
+		instanceOffset = ~0u;
+		setInstanceOffset(0);
+	}
+}
+
+void GeometryHeap::setInstanceOffset(GLuint baseInstance) {
+	if (baseInstance == instanceOffset)
+		return;
+
+	glBindBuffer(GL_ARRAY_BUFFER, instanceBuffer);
+	for (const auto& attribute : instanceFormat.attributes) {
+		std::size_t offset = attribute.offset + (std::size_t)baseInstance * instanceFormat.stride;
+		glVertexAttribPointer(attribute.index, attribute.size, attribute.type, GL_FALSE, instanceFormat.stride, (void*)offset);
+	}
+	instanceOffset = baseInstance;
+}
+
+void GeometryHeap::growBuffer(unsigned int& buffer, std::size_t oldSize, std::size_t newSize) {
+	unsigned int newBuffer;
+	glGenBuffers(1, &newBuffer);
+
+	glBindBuffer(GL_COPY_WRITE_BUFFER, newBuffer);
+	glBufferData(GL_COPY_WRITE_BUFFER, newSize, NULL, GL_STATIC_DRAW);
+	glBindBuffer(GL_COPY_READ_BUFFER, buffer);
+	glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, oldSize);
+	glBindBuffer(GL_COPY_READ_BUFFER, 0);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+
+	glDeleteBuffers(1, &buffer);
+	buffer = newBuffer;
+}
+
+GeometryRange GeometryHeap::Allocate(const void* vertices, unsigned int vertexCount, const unsigned int* indices, unsigned int indexCount) {
+	GeometryRange range;
+	if (vertexCount == 0 || indexCount == 0)
+		return range;
+
+	unsigned int vertexOffset = vertexAllocator.Allocate(vertexCount);
+	bool grown = false;
+	while (vertexOffset == RangeAllocator::INVALID) {
+		unsigned int oldCapacity = vertexAllocator.Capacity();
+		unsigned int newCapacity = std::max(oldCapacity * 2, oldCapacity + vertexCount);
+		growBuffer(VBO, (std::size_t)oldCapacity * format.stride, (std::size_t)newCapacity * format.stride);
+		vertexAllocator.Grow(newCapacity);
+		vertexOffset = vertexAllocator.Allocate(vertexCount);
+		grown = true;
+	}
+
+	unsigned int indexOffset = indexAllocator.Allocate(indexCount);
+	while (indexOffset == RangeAllocator::INVALID) {
+		unsigned int oldCapacity = indexAllocator.Capacity();
+		unsigned int newCapacity = std::max(oldCapacity * 2, oldCapacity + indexCount);
+		growBuffer(EBO, (std::size_t)oldCapacity * sizeof(unsigned int), (std::size_t)newCapacity * sizeof(unsigned int));
+		indexAllocator.Grow(newCapacity);
+		indexOffset = indexAllocator.Allocate(indexCount);
+		grown = true;
+	}
+
+	// the VAO still points at the old buffers after a resize
+	if (grown)
+		setupVAO();
+
+	glBindBuffer(GL_COPY_WRITE_BUFFER, VBO);
+	glBufferSubData(GL_COPY_WRITE_BUFFER, (GLintptr)vertexOffset * format.stride, (GLsizeiptr)vertexCount * format.stride, vertices);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, EBO);
+	glBufferSubData(GL_COPY_WRITE_BUFFER, (GLintptr)indexOffset * sizeof(unsigned int), (GLsizeiptr)indexCount * sizeof(unsigned int), indices);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+
+	range.baseVertex = (GLint)vertexOffset;
+	range.vertexCount = vertexCount;
+	range.firstIndex = indexOffset;
+	range.indexCount = indexCount;
+	return range;
+}
+
+void GeometryHeap::Free(const GeometryRange& range) {
+	vertexAllocator.Free((unsigned int)range.baseVertex, range.vertexCount);
+	indexAllocator.Free(range.firstIndex, range.indexCount);
+}
+
+void GeometryHeap::UpdateVertices(const GeometryRange& range, const void* vertices) {
+	glBindBuffer(GL_COPY_WRITE_BUFFER, VBO);
+	glBufferSubData(GL_COPY_WRITE_BUFFER, (GLintptr)range.baseVertex * format.stride, (GLsizeiptr)range.vertexCount * format.stride, vertices);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+}
+
+void GeometryHeap::Read(const GeometryRange& range, void* vertices, unsigned int* indices) const {
+	if (vertices) {
+		glBindBuffer(GL_COPY_READ_BUFFER, VBO);
+		glGetBufferSubData(GL_COPY_READ_BUFFER, (GLintptr)range.baseVertex * format.stride, (GLsizeiptr)range.vertexCount * format.stride, vertices);
+	}
+	if (indices) {
+		glBindBuffer(GL_COPY_READ_BUFFER, EBO);
+		glGetBufferSubData(GL_COPY_READ_BUFFER, (GLintptr)range.firstIndex * sizeof(unsigned int), (GLsizeiptr)range.indexCount * sizeof(unsigned int), indices);
+	}
+	glBindBuffer(GL_COPY_READ_BUFFER, 0);
+}
+
+void GeometryHeap::Bind() {
+	if (boundVAO != VAO) {
+		glBindVertexArray(VAO);
+		boundVAO = VAO;
+	}
+}
+
+void GeometryHeap::BindExternal(unsigned int vao) {
+	glBindVertexArray(vao);
+	boundVAO = vao;
+}
+
+void GeometryHeap::Draw(const GeometryRange& range, GLenum mode) {
+	Bind();
+	glDrawElementsBaseVertex(mode, range.indexCount, GL_UNSIGNED_INT, range.IndexOffset(), range.baseVertex);
+}
+
+void GeometryHeap::DrawInstanced(const GeometryRange& range, GLsizei instanceCount, GLuint baseInstance, GLenum mode) {
+	Bind();
+	if (GLAD_GL_VERSION_4_2) {
+		// the multi-draws may have moved the attribute pointers
+		setInstanceOffset(0);
+		glDrawElementsInstancedBaseVertexBaseInstance(mode, range.indexCount, GL_UNSIGNED_INT, range.IndexOffset(),
+			instanceCount, range.baseVertex, baseInstance);
+	} else {
+		// no base instance before 4.2, move the instance attribute pointers instead
+		setInstanceOffset(baseInstance);
+		glDrawElementsInstancedBaseVertex(mode, range.indexCount, GL_UNSIGNED_INT, range.IndexOffset(),
+			instanceCount, range.baseVertex);
+	}
+}
+
+void GeometryHeap::MultiDrawIndirect(GLintptr commandOffset, GLsizei drawCount, GLuint baseInstance, GLenum mode) {
+	Bind();
+	setInstanceOffset(baseInstance);
+	glMultiDrawElementsIndirect(mode, GL_UNSIGNED_INT, (const void*)commandOffset, drawCount, 0);
+}
+
+void GeometryHeap::MultiDraw(const GLsizei* counts, const void* const* indexOffsets, const GLint* baseVertices, GLsizei drawCount,
+	GLuint baseInstance, GLenum mode) {
+	Bind();
+	// non-instanced draws read instance 0 of the attribute pointers
+	setInstanceOffset(baseInstance);
+	glMultiDrawElementsBaseVertex(mode, counts, GL_UNSIGNED_INT, indexOffsets, drawCount, baseVertices);
+}
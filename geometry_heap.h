@@ -0,0 +1,114 @@
+#ifndef GEOMETRY_HEAP_H
+#define GEOMETRY_HEAP_H
+
+#include <glad/glad.h>
+
+#include <cstddef>
+#include <map>
+#include <vector>
+
+// first-fit free-list allocator over a linear range of elements.
+// free ranges are kept sorted by offset so neighbours can be merged on release.
+class RangeAllocator {
+public:
+    static const unsigned int INVALID = 0xFFFFFFFFu;
+
+    RangeAllocator(unsigned int capacity = 0);
+
+    // returns the offset of a free block of 'count' elements or INVALID if none fits
+    unsigned int Allocate(unsigned int count);
+    void Free(unsigned int offset, unsigned int count);
+    // extends the range, the new tail becomes free space
+    void Grow(unsigned int newCapacity);
+
+    unsigned int Capacity() const { return capacity; }
+    unsigned int Used() const { return used; }
+private:
+    unsigned int capacity;
+    unsigned int used;
+    std::map<unsigned int, unsigned int> freeRanges; // offset -> count
+};
+
+struct VertexAttribute {
+    GLuint index;
+    GLint size;
+    GLenum type;
+    std::size_t offset;
+    bool integer = false; // read as ivec/uvec through glVertexAttribIPointer
+};
+
+struct VertexFormat {
+    GLsizei stride;
+    std::vector<VertexAttribute> attributes;
+};
+
+// a sub-allocation inside a GeometryHeap.
+// indices are relative to the first vertex so they stay valid wherever the block lands.
+struct GeometryRange {
+    GLint baseVertex = 0;
+    unsigned int vertexCount = 0;
+    unsigned int firstIndex = 0;
+    unsigned int indexCount = 0;
+
+    const void* IndexOffset() const { return (const void*)(firstIndex * sizeof(unsigned int)); }
+};
+
+// layout consumed by glMultiDrawElementsIndirect / glDrawElementsIndirect
+struct DrawElementsIndirectCommand {
+    GLuint count;
+    GLuint instanceCount;
+    GLuint firstIndex;
+    GLint baseVertex;
+    GLuint baseInstance;
+};
+
+// one large vertex buffer + one large index buffer sharing a single VAO for a vertex format.
+// every mesh of that format lives in here, so drawing them never switches VAOs.
+class GeometryHeap {
+public:
+    GeometryHeap(VertexFormat format, unsigned int vertexCapacity, unsigned int indexCapacity,
+        unsigned int instanceBuffer = 0, VertexFormat instanceFormat = {});
+
+    GeometryRange Allocate(const void* vertices, unsigned int vertexCount, const unsigned int* indices, unsigned int indexCount);
+    void Free(const GeometryRange& range);
+    // overwrites the vertices of a block, e.g. for CPU-deformed meshes
+    void UpdateVertices(const GeometryRange& range, const void* vertices);
+    // copies a block back from the GPU, either pointer may be null
+    void Read(const GeometryRange& range, void* vertices, unsigned int* indices) const;
+
+    // binds the shared VAO, skipping the call when it is already bound
+    void Bind();
+    // binds a VAO that belongs to no heap without breaking the cached binding
+    static void BindExternal(unsigned int vao);
+    void Draw(const GeometryRange& range, GLenum mode = GL_TRIANGLES);
+    // draws instanceCount copies, reading per-instance attributes starting at baseInstance
+    void DrawInstanced(const GeometryRange& range, GLsizei instanceCount, GLuint baseInstance, GLenum mode = GL_TRIANGLES);
+    // glMultiDrawElementsIndirect over the bound GL_DRAW_INDIRECT_BUFFER (GL 4.3+). the commands'
+    // base instances count from baseInstance, so the command buffer can stay static while the
+    // instance data moves through a streaming buffer
+    void MultiDrawIndirect(GLintptr commandOffset, GLsizei drawCount, GLuint baseInstance, GLenum mode = GL_TRIANGLES);
+    // glMultiDrawElementsBaseVertex, every draw reads the one instance at baseInstance
+    void MultiDraw(const GLsizei* counts, const void* const* indexOffsets, const GLint* baseVertices, GLsizei drawCount,
+        GLuint baseInstance, GLenum mode = GL_TRIANGLES);
+
+    unsigned int GetVAO() const { return VAO; }
+    unsigned int GetVBO() const { return VBO; }
+    unsigned int GetEBO() const { return EBO; }
+    const VertexFormat& Format() const { return format; }
+private:
+    VertexFormat format;
+    VertexFormat instanceFormat;
+    RangeAllocator vertexAllocator;
+    RangeAllocator indexAllocator;
+    unsigned int VAO, VBO, EBO;
+    unsigned int instanceBuffer;
+    GLuint instanceOffset; // base instance the attribute pointers currently start at
+
+    static unsigned int boundVAO;
+
+    void setupVAO();
+    void setInstanceOffset(GLuint baseInstance);
+    void growBuffer(unsigned int& buffer, std::size_t oldSize, std::size_t newSize);
+};
+
+#endif
@@ -0,0 +1,31 @@
+#include "gpu_timer.h"
+
+namespace {
+	const double SMOOTHING = 0.1;
+}
+
+GpuTimer::GpuTimer() : next(0), milliseconds(0.0) {
+	glGenQueries(SLOTS, queries);
+	for (int i = 0; i < SLOTS; i++)
+		issued[i] = false;
+}
+
+GpuTimer::~GpuTimer() {
+	glDeleteQueries(SLOTS, queries);
+}
+
+void GpuTimer::Begin() {
+	if (issued[next]) {
+		GLuint64 elapsed = 0;
+		glGetQueryObjectui64v(queries[next], GL_QUERY_RESULT, &elapsed);
+		double sample = elapsed / 1e6;
+		milliseconds = milliseconds == 0.0 ? sample : milliseconds + (sample - milliseconds) * SMOOTHING;
+	}
+	glBeginQuery(GL_TIME_ELAPSED, queries[next]);
+}
+
+void GpuTimer::End() {
+	glEndQuery(GL_TIME_ELAPSED);
+	issued[next] = true;
+	next = (next + 1) % SLOTS;
+}
@@ -0,0 +1,28 @@
+#ifndef GPU_TIMER_H
+#define GPU_TIMER_H
+
+#include <glad/glad.h>
+
+// GPU time of a section of commands, smoothed over frames.
+// every measurement has its own query and is only read back when its slot comes round again,
+// by then the GPU has long finished it, so reading never stalls.
+class GpuTimer {
+public:
+    GpuTimer();
+    ~GpuTimer();
+
+    void Begin();
+    void End();
+
+    // 0 until the first measurement came back
+    double Milliseconds() const { return milliseconds; }
+private:
+    static const int SLOTS = 4;
+
+    GLuint queries[SLOTS];
+    bool issued[SLOTS];
+    int next;
+    double milliseconds;
+};
+
+#endif
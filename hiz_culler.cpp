@@ -0,0 +1,256 @@
+#include "hiz_culler.h"
+#include "geometry_heap.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstring>
+
+namespace {
+	// framebuffer, viewport and the states the culling passes turn off
+	struct SavedState {
+		GLint framebuffer;
+		GLint viewport[4];
+		GLboolean depthTest, blend;
+
+		SavedState() {
+			glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &framebuffer);
+			glGetIntegerv(GL_VIEWPORT, viewport);
+			depthTest = glIsEnabled(GL_DEPTH_TEST);
+			blend = glIsEnabled(GL_BLEND);
+			glDisable(GL_DEPTH_TEST);
+			glDisable(GL_BLEND);
+		}
+		~SavedState() {
+			glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+			glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+			if (depthTest)
+				glEnable(GL_DEPTH_TEST);
+			if (blend)
+				glEnable(GL_BLEND);
+		}
+	};
+}
+
+HiZCuller::HiZCuller(int width, int height)
+	: width(width), height(height),
+	copyShader("./shaders/fullscreen.vs", "./shaders/hiz_copy.fs"),
+	downsampleShader("./shaders/fullscreen.vs", "./shaders/hiz_downsample.fs"),
+	testShader("./shaders/hiz_test.vs", "./shaders/hiz_test.fs"),
+	objectCount(0), readbackCount(0), readbackFence(0) {
+	glGenTextures(1, &depthTexture);
+	glBindTexture(GL_TEXTURE_2D, depthTexture);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, 0);
+
+	glGenTextures(1, &pyramidTexture);
+	glBindTexture(GL_TEXTURE_2D, pyramidTexture);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	glGenFramebuffers(1, &pyramidFBO);
+	allocateTargets();
+
+	// one texel per object, written by the test pass and read back
+	visibilityRows = 1;
+	glGenTextures(1, &visibilityTexture);
+	glBindTexture(GL_TEXTURE_2D, visibilityTexture);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_R8, VISIBILITY_WIDTH, visibilityRows, 0, GL_RED, GL_UNSIGNED_BYTE, NULL);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glBindTexture(GL_TEXTURE_2D, 0);
+
+	GLint previousFramebuffer;
+	glGetIntegerv(GL_FRAMEBUFFER_BINDING, &previousFramebuffer);
+	glGenFramebuffers(1, &visibilityFBO);
+	glBindFramebuffer(GL_FRAMEBUFFER, visibilityFBO);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, visibilityTexture, 0);
+	if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+		std::cout << "Hi-Z visibility framebuffer not complete!" << std::endl;
+	glBindFramebuffer(GL_FRAMEBUFFER, previousFramebuffer);
+
+	// one point per object, the bounds are its attributes
+	glGenVertexArrays(1, &boundsVAO);
+	glGenBuffers(1, &boundsVBO);
+	GeometryHeap::BindExternal(boundsVAO);
+	glBindBuffer(GL_ARRAY_BUFFER, boundsVBO);
+	glBufferData(GL_ARRAY_BUFFER, sizeof(AABB), NULL, GL_STREAM_DRAW);
+	glEnableVertexAttribArray(0);
+	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(AABB), (void*)offsetof(AABB, min));
+	glEnableVertexAttribArray(1);
+	glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(AABB), (void*)offsetof(AABB, max));
+	// the fullscreen passes generate their vertices from gl_VertexID
+	glGenVertexArrays(1, &emptyVAO);
+	GeometryHeap::BindExternal(0);
+
+	glGenBuffers(1, &readbackBuffer);
+
+	copyShader.use();
+	copyShader.setInt("depth", 0);
+	downsampleShader.use();
+	downsampleShader.setInt("previous", 0);
+	testShader.use();
+	testShader.setInt("hiz", 0);
+	testShader.setInt("visibilityWidth", VISIBILITY_WIDTH);
+}
+
+// storage is re-specified on the same texture names, so framebuffers holding the depth texture stay valid
+void HiZCuller::allocateTargets() {
+	levels = (int)std::floor(std::log2((float)std::max(width, height))) + 1;
+
+	glBindTexture(GL_TEXTURE_2D, depthTexture);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT32F, width, height, 0, GL_DEPTH_COMPONENT, GL_FLOAT, NULL);
+
+	// level i is max(1, size >> i), the downsample pass folds the odd row and column in
+	glBindTexture(GL_TEXTURE_2D, pyramidTexture);
+	for (int level = 0; level < levels; level++) {
+		glTexImage2D(GL_TEXTURE_2D, level, GL_R32F, std::max(1, width >> level), std::max(1, height >> level),
+			0, GL_RED, GL_FLOAT, NULL);
+	}
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, levels - 1);
+	glBindTexture(GL_TEXTURE_2D, 0);
+}
+
+void HiZCuller::Resize(int width, int height) {
+	if (width == this->width && height == this->height)
+		return;
+	this->width = width;
+	this->height = height;
+	allocateTargets();
+}
+
+void HiZCuller::collectReadback() {
+	if (!readbackFence)
+		return;
+	GLenum status = glClientWaitSync(readbackFence, 0, 0);
+	if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED)
+		return;
+	glDeleteSync(readbackFence);
+	readbackFence = 0;
+
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, readbackBuffer);
+	const uint8_t* data = (const uint8_t*)glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, readbackCount, GL_MAP_READ_BIT);
+	if (data) {
+		visibility.assign(data, data + readbackCount);
+		glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+	}
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+}
+
+void HiZCuller::Begin(std::span<const AABB> bounds) {
+	collectReadback();
+
+	objectCount = (unsigned int)bounds.size();
+	objectQueries.assign(objectCount, 0);
+	if (objectCount == 0)
+		return;
+
+	glBindBuffer(GL_ARRAY_BUFFER, boundsVBO);
+	glBufferData(GL_ARRAY_BUFFER, (GLsizeiptr)bounds.size_bytes(), bounds.data(), GL_STREAM_DRAW);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+	unsigned int rows = (objectCount + VISIBILITY_WIDTH - 1) / VISIBILITY_WIDTH;
+	if (rows > visibilityRows) {
+		visibilityRows = rows;
+		glBindTexture(GL_TEXTURE_2D, visibilityTexture);
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_R8, VISIBILITY_WIDTH, visibilityRows, 0, GL_RED, GL_UNSIGNED_BYTE, NULL);
+		glBindTexture(GL_TEXTURE_2D, 0);
+	}
+}
+
+bool HiZCuller::WasVisible(unsigned int object) const {
+	return object >= visibility.size() || visibility[object] != 0;
+}
+
+GLuint HiZCuller::Query(unsigned int object) const {
+	return object < objectQueries.size() ? objectQueries[object] : 0;
+}
+
+void HiZCuller::BuildPyramid() {
+	SavedState saved;
+	glBindFramebuffer(GL_FRAMEBUFFER, pyramidFBO);
+	GeometryHeap::BindExternal(emptyVAO);
+	glActiveTexture(GL_TEXTURE0);
+
+	// level 0 is a copy of the depth buffer
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, pyramidTexture, 0);
+	glViewport(0, 0, width, height);
+	copyShader.use();
+	glBindTexture(GL_TEXTURE_2D, depthTexture);
+	glDrawArrays(GL_TRIANGLES, 0, 3);
+
+	// every further level reads only the one above it, so it is never sampled while being written
+	downsampleShader.use();
+	glBindTexture(GL_TEXTURE_2D, pyramidTexture);
+	for (int level = 1; level < levels; level++) {
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, level - 1);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, level - 1);
+		glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, pyramidTexture, level);
+		glViewport(0, 0, std::max(1, width >> level), std::max(1, height >> level));
+		glDrawArrays(GL_TRIANGLES, 0, 3);
+	}
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, 0);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, levels - 1);
+	glBindTexture(GL_TEXTURE_2D, 0);
+}
+
+void HiZCuller::Test(const glm::mat4& viewProjection, std::span<const unsigned int> retest) {
+	if (objectCount == 0)
+		return;
+
+	{
+		SavedState saved;
+		glBindFramebuffer(GL_FRAMEBUFFER, visibilityFBO);
+		glViewport(0, 0, VISIBILITY_WIDTH, visibilityRows);
+		const GLfloat hidden[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+		glClearBufferfv(GL_COLOR, 0, hidden);
+
+		testShader.use();
+		testShader.setMat4("viewProjection", viewProjection);
+		testShader.setInt("levels", levels);
+		testShader.setInt("visibilityHeight", (int)visibilityRows);
+		glActiveTexture(GL_TEXTURE0);
+		glBindTexture(GL_TEXTURE_2D, pyramidTexture);
+		GeometryHeap::BindExternal(boundsVAO);
+
+		// the fragment of an occluded object is discarded, so the point drawn for it
+		// leaves its texel at 0 and its query without samples
+		glDrawArrays(GL_POINTS, 0, (GLsizei)objectCount);
+
+		if (queryPool.size() < retest.size()) {
+			std::size_t first = queryPool.size();
+			queryPool.resize(retest.size());
+			glGenQueries((GLsizei)(retest.size() - first), queryPool.data() + first);
+		}
+		for (std::size_t i = 0; i < retest.size(); i++) {
+			unsigned int object = retest[i];
+			if (object >= objectCount)
+				continue;
+			glBeginQuery(GL_ANY_SAMPLES_PASSED, queryPool[i]);
+			glDrawArrays(GL_POINTS, (GLint)object, 1);
+			glEndQuery(GL_ANY_SAMPLES_PASSED);
+			objectQueries[object] = queryPool[i];
+		}
+		glBindTexture(GL_TEXTURE_2D, 0);
+	}
+
+	// one readback in flight at a time, a slow GPU just keeps the older results a little longer
+	if (readbackFence)
+		return;
+	GLint previousReadFramebuffer;
+	glGetIntegerv(GL_READ_FRAMEBUFFER_BINDING, &previousReadFramebuffer);
+	glBindFramebuffer(GL_READ_FRAMEBUFFER, visibilityFBO);
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, readbackBuffer);
+	glBufferData(GL_PIXEL_PACK_BUFFER, (GLsizeiptr)VISIBILITY_WIDTH * visibilityRows, NULL, GL_STREAM_READ);
+	glPixelStorei(GL_PACK_ALIGNMENT, 1);
+	glReadPixels(0, 0, VISIBILITY_WIDTH, visibilityRows, GL_RED, GL_UNSIGNED_BYTE, NULL);
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+	glBindFramebuffer(GL_READ_FRAMEBUFFER, previousReadFramebuffer);
+
+	readbackCount = objectCount;
+	readbackFence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+}
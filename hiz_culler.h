@@ -0,0 +1,68 @@
+#ifndef HIZ_CULLER_H
+#define HIZ_CULLER_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include "shader.h"
+#include "bounds.h"
+
+#include <cstdint>
+#include <span>
+#include <vector>
+
+// GPU occlusion culling against a hierarchical depth buffer.
+// a frame is drawn in two phases:
+//   1. objects that passed the test last frame are drawn, then their depth is reduced into
+//      a mip pyramid where every texel keeps the farthest depth of the texels below it
+//   2. every object's bounds are tested against the pyramid. objects that failed last frame
+//      are tested under an occlusion query, so the ones that became visible can be drawn
+//      right away with conditional rendering instead of popping in a frame late.
+// the results of phase 2 are read back asynchronously and pick the objects of the next phase 1.
+class HiZCuller {
+public:
+    HiZCuller(int width, int height);
+    // reallocates the depth texture and the pyramid, last frame's visibility is kept
+    void Resize(int width, int height);
+
+    // depth attachment of the scene framebuffer, the pyramid is built from it
+    unsigned int DepthTexture() const { return depthTexture; }
+    unsigned int PyramidTexture() const { return pyramidTexture; }
+    int Levels() const { return levels; }
+
+    // starts a frame with the world-space bounds of every object, indexed by object id.
+    // picks up the last finished readback.
+    void Begin(std::span<const AABB> bounds);
+    // result of the last readback, objects that were never tested count as visible
+    bool WasVisible(unsigned int object) const;
+
+    // reduces the depth drawn so far into the pyramid
+    void BuildPyramid();
+    // tests every object against the pyramid, the ones in 'retest' also get an occlusion query
+    void Test(const glm::mat4& viewProjection, std::span<const unsigned int> retest);
+    // query of the object's last Test(), 0 if it had none
+    GLuint Query(unsigned int object) const;
+private:
+    static const int VISIBILITY_WIDTH = 256;
+
+    int width, height, levels;
+    unsigned int depthTexture, pyramidTexture, pyramidFBO;
+    unsigned int visibilityTexture, visibilityFBO, visibilityRows;
+    unsigned int boundsVAO, boundsVBO, emptyVAO;
+    Shader copyShader, downsampleShader, testShader;
+
+    unsigned int objectCount;
+    std::vector<GLuint> queryPool;
+    std::vector<GLuint> objectQueries; // per object, 0 when not queried
+
+    // async readback of the visibility texture
+    unsigned int readbackBuffer;
+    unsigned int readbackCount;
+    GLsync readbackFence;
+    std::vector<uint8_t> visibility;
+
+    void allocateTargets();
+    void collectReadback();
+};
+
+#endif
@@ -0,0 +1,55 @@
+#include "instance_buffer.h"
+#include "simd_math.h"
+
+#include <algorithm>
+#include <cstddef>
+
+InstanceBuffer::InstanceBuffer(unsigned int capacity) : capacity(capacity), cursor(0) {
+	glGenBuffers(1, &buffer);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+	glBufferData(GL_COPY_WRITE_BUFFER, (GLsizeiptr)capacity * sizeof(InstanceData), NULL, GL_STREAM_DRAW);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+}
+
+VertexFormat InstanceBuffer::Format() {
+	return { sizeof(InstanceData), {
+		{ 4, 4, GL_FLOAT, offsetof(InstanceData, Model) },
+		{ 5, 4, GL_FLOAT, offsetof(InstanceData, Model) + sizeof(glm::vec4) },
+		{ 6, 4, GL_FLOAT, offsetof(InstanceData, Model) + 2 * sizeof(glm::vec4) },
+		{ 7, 4, GL_FLOAT, offsetof(InstanceData, Model) + 3 * sizeof(glm::vec4) },
+		{ 8, 3, GL_FLOAT, offsetof(InstanceData, NormalMatrix) },
+		{ 9, 3, GL_FLOAT, offsetof(InstanceData, NormalMatrix) + sizeof(glm::vec3) },
+		{ 10, 3, GL_FLOAT, offsetof(InstanceData, NormalMatrix) + 2 * sizeof(glm::vec3) },
+	} };
+}
+
+GLuint InstanceBuffer::Upload(std::span<const glm::mat4> models) {
+	unsigned int count = (unsigned int)models.size();
+	if (count == 0)
+		return 0;
+
+	normalMatrices.resize(count);
+	NormalMatrices(models, normalMatrices);
+
+	glBindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+	if (cursor + count > capacity) {
+		// orphan the storage: draws still in flight keep the old one
+		capacity = std::max(capacity, count);
+		glBufferData(GL_COPY_WRITE_BUFFER, (GLsizeiptr)capacity * sizeof(InstanceData), NULL, GL_STREAM_DRAW);
+		cursor = 0;
+	}
+
+	// the written range was never used since the last orphan, so no need to sync with the GPU
+	InstanceData* data = (InstanceData*)glMapBufferRange(GL_COPY_WRITE_BUFFER, (GLintptr)cursor * sizeof(InstanceData),
+		(GLsizeiptr)count * sizeof(InstanceData), GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
+	for (unsigned int i = 0; i < count; i++) {
+		data[i].Model = models[i];
+		data[i].NormalMatrix = normalMatrices[i];
+	}
+	glUnmapBuffer(GL_COPY_WRITE_BUFFER);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+
+	GLuint baseInstance = cursor;
+	cursor += count;
+	return baseInstance;
+}
@@ -0,0 +1,36 @@
+#ifndef INSTANCE_BUFFER_H
+#define INSTANCE_BUFFER_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include "geometry_heap.h"
+
+#include <span>
+#include <vector>
+
+// per-instance attributes read by instanced shaders (locations 4-7 and 8-10)
+struct InstanceData {
+    glm::mat4 Model;
+    glm::mat3 NormalMatrix;
+};
+
+// streaming buffer of per-instance transforms.
+// uploads are appended until the buffer is full, then the storage is orphaned and writing restarts at 0.
+class InstanceBuffer {
+public:
+    InstanceBuffer(unsigned int capacity = 1024);
+
+    // writes the transforms and their normal matrices, returns the base instance to draw them with
+    GLuint Upload(std::span<const glm::mat4> models);
+
+    unsigned int GetBuffer() const { return buffer; }
+    static VertexFormat Format();
+private:
+    unsigned int buffer;
+    unsigned int capacity;
+    unsigned int cursor;
+    std::vector<glm::mat3> normalMatrices; // upload scratch
+};
+
+#endif
@@ -0,0 +1,97 @@
+#include "job_system.h"
+
+#include <algorithm>
+
+JobSystem::JobSystem(unsigned int workerCount)
+	: stop(false), job(nullptr), jobCount(0), jobGrain(1), generation(0), nextIndex(0), remainingChunks(0), busyWorkers(0) {
+	if (workerCount == 0) {
+		unsigned int hardwareThreads = std::thread::hardware_concurrency();
+		workerCount = hardwareThreads > 1 ? hardwareThreads - 1 : 0;
+	}
+	for (unsigned int i = 0; i < workerCount; i++) {
+		workers.emplace_back(&JobSystem::workerLoop, this);
+	}
+}
+
+JobSystem::~JobSystem() {
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		stop = true;
+	}
+	wake.notify_all();
+	for (auto& worker : workers) {
+		worker.join();
+	}
+}
+
+JobSystem& JobSystem::Get() {
+	static JobSystem jobSystem;
+	return jobSystem;
+}
+
+void JobSystem::runChunks(const std::function<void(unsigned int, unsigned int)>& fn, unsigned int count, unsigned int grain) {
+	while (true) {
+		unsigned int begin = nextIndex.fetch_add(grain);
+		if (begin >= count)
+			break;
+		fn(begin, std::min(begin + grain, count));
+
+		if (remainingChunks.fetch_sub(1) == 1) {
+			std::lock_guard<std::mutex> lock(mutex);
+			finished.notify_all();
+		}
+	}
+}
+
+void JobSystem::workerLoop() {
+	unsigned int seen = 0;
+	while (true) {
+		const std::function<void(unsigned int, unsigned int)>* fn;
+		unsigned int count, grain;
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			wake.wait(lock, [&] { return stop || (job && generation != seen); });
+			if (stop)
+				return;
+			seen = generation;
+			fn = job;
+			count = jobCount;
+			grain = jobGrain;
+			// the caller waits for busy workers, so the job cannot be replaced under us
+			busyWorkers++;
+		}
+
+		runChunks(*fn, count, grain);
+
+		std::lock_guard<std::mutex> lock(mutex);
+		busyWorkers--;
+		finished.notify_all();
+	}
+}
+
+void JobSystem::ParallelFor(unsigned int count, unsigned int grain, const std::function<void(unsigned int, unsigned int)>& fn) {
+	if (count == 0)
+		return;
+	grain = std::max(grain, 1u);
+	if (workers.empty() || count <= grain) {
+		fn(0, count);
+		return;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		job = &fn;
+		jobCount = count;
+		jobGrain = grain;
+		nextIndex = 0;
+		remainingChunks = (count + grain - 1) / grain;
+		generation++;
+	}
+	wake.notify_all();
+
+	runChunks(fn, count, grain);
+
+	std::unique_lock<std::mutex> lock(mutex);
+	finished.wait(lock, [&] { return remainingChunks == 0 && busyWorkers == 0; });
+	job = nullptr;
+}
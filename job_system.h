@@ -0,0 +1,49 @@
+#ifndef JOB_SYSTEM_H
+#define JOB_SYSTEM_H
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// small pool of worker threads for data-parallel loops.
+// one ParallelFor runs at a time and the calling thread works on it too.
+class JobSystem {
+public:
+    // 0 picks one worker per hardware thread besides the caller
+    JobSystem(unsigned int workerCount = 0);
+    ~JobSystem();
+
+    JobSystem(const JobSystem&) = delete;
+    JobSystem& operator=(const JobSystem&) = delete;
+
+    // calls fn(begin, end) over [0, count) in chunks of 'grain' items and blocks until all are done
+    void ParallelFor(unsigned int count, unsigned int grain, const std::function<void(unsigned int, unsigned int)>& fn);
+
+    unsigned int ThreadCount() const { return (unsigned int)workers.size() + 1; }
+
+    // process-wide pool
+    static JobSystem& Get();
+private:
+    std::vector<std::thread> workers;
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::condition_variable finished;
+    bool stop;
+
+    // current job, written under the mutex before the generation is bumped
+    const std::function<void(unsigned int, unsigned int)>* job;
+    unsigned int jobCount;
+    unsigned int jobGrain;
+    unsigned int generation;
+    std::atomic<unsigned int> nextIndex;
+    std::atomic<unsigned int> remainingChunks;
+    unsigned int busyWorkers;
+
+    void workerLoop();
+    void runChunks(const std::function<void(unsigned int, unsigned int)>& fn, unsigned int count, unsigned int grain);
+};
+
+#endif
@@ -0,0 +1,46 @@
+#include "lights.h"
+
+#include <cmath>
+
+float InfluenceRadius(const glm::vec3& color, float threshold) {
+	float luminance = glm::dot(color, glm::vec3(0.2126f, 0.7152f, 0.0722f));
+	return luminance > 0.0f ? std::sqrt(luminance / threshold) : 0.0f;
+}
+
+void ObjectLightLists::Build(std::span<const AABB> bounds, std::span<const PointLight> lights) {
+	std::size_t objects = bounds.size();
+	boxes.Resize(objects);
+	for (std::size_t i = 0; i < objects; i++)
+		boxes.Set(i, bounds[i].min, bounds[i].max);
+
+	// one pass over all boxes per light, the pairs come out sorted by light
+	hits.resize(objects);
+	reached.assign(lights.size(), 0);
+	pairs.clear();
+	for (std::size_t l = 0; l < lights.size(); l++) {
+		if (objects == 0 || lights[l].radius <= 0.0f)
+			continue;
+		SphereOverlapsAABBs(boxes, 0, lights[l].position, lights[l].radius, hits);
+		for (std::size_t i = 0; i < objects; i++) {
+			if (!hits[i])
+				continue;
+			pairs.push_back((uint32_t)i);
+			pairs.push_back((uint32_t)l);
+			reached[l] = 1;
+		}
+	}
+
+	// counting sort by object, stable so every list keeps the lights in order
+	offsets.assign(objects + 1, 0u);
+	for (std::size_t p = 0; p < pairs.size(); p += 2)
+		offsets[pairs[p] + 1]++;
+	for (std::size_t i = 0; i < objects; i++)
+		offsets[i + 1] += offsets[i];
+	indices.resize(pairs.size() / 2);
+	for (std::size_t p = 0; p < pairs.size(); p += 2)
+		indices[offsets[pairs[p]]++] = pairs[p + 1];
+	// the fill advanced every offset to the start of the next object
+	for (std::size_t i = objects; i > 0; i--)
+		offsets[i] = offsets[i - 1];
+	offsets[0] = 0;
+}
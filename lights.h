@@ -0,0 +1,47 @@
+#ifndef LIGHTS_H
+#define LIGHTS_H
+
+#include <glm/glm.hpp>
+
+#include "bounds.h"
+#include "simd_math.h"
+
+#include <cstdint>
+#include <span>
+#include <vector>
+
+struct PointLight {
+    glm::vec3 position;
+    glm::vec3 color;
+    float radius; // no influence beyond this distance
+};
+
+// luminance below which a light no longer visibly contributes at exposure 1
+const float LIGHT_CUTOFF = 0.005f;
+
+// distance at which the inverse-square falloff of the light's luminance drops to threshold.
+// the shaders window the falloff so it reaches zero exactly there.
+float InfluenceRadius(const glm::vec3& color, float threshold = LIGHT_CUTOFF);
+
+// for every object, the lights whose influence sphere touches its world bounds
+class ObjectLightLists {
+public:
+    void Build(std::span<const AABB> bounds, std::span<const PointLight> lights);
+
+    std::span<const uint32_t> Lights(std::size_t object) const {
+        return std::span<const uint32_t>(indices.data() + offsets[object], offsets[object + 1] - offsets[object]);
+    }
+    // whether the light touches any object at all
+    bool Reaches(std::size_t light) const { return reached[light] != 0; }
+    // light references over all objects, compared to lights * objects
+    std::size_t ReferenceCount() const { return indices.size(); }
+private:
+    AABBArray boxes;
+    std::vector<uint8_t> hits;
+    std::vector<uint8_t> reached;
+    std::vector<uint32_t> pairs; // object, light
+    std::vector<uint32_t> offsets; // objects + 1
+    std::vector<uint32_t> indices;
+};
+
+#endif
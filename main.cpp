@@ -8,11 +8,25 @@
 #include "stb_image.h"
 #include "camera.h"
 #include "model.h"
+#include "render_queue.h"
+#include "scene_graph.h"
+#include "bvh.h"
+#include "occlusion_culler.h"
+#include "hiz_culler.h"
+#include "clustered_lights.h"
+#include "deferred_renderer.h"
+#include "render_graph.h"
+#include "bloom.h"
+#include "gpu_timer.h"
+#include "gaussian_blur.h"
+#include "auto_exposure.h"
+#include "post_process.h"
 
 #include <iostream>
 #include <string>
 #include <vector>
 #include <algorithm>
+#include <cmath>
 #include <numeric>
 
 using std::vector;
@@ -25,6 +39,8 @@ void scroll_callback(GLFWwindow* window, double xoffset, double yoffset);
 // settings
 const unsigned int SCR_WIDTH = 800;
 const unsigned int SCR_HEIGHT = 600;
+// current framebuffer size, updated on resize
+int framebufferWidth = SCR_WIDTH, framebufferHeight = SCR_HEIGHT;
 
 float deltaTime = 0.0f;
 float lastFrame = 0.0f;
@@ -33,14 +49,19 @@ float lastX = 400., lastY = 300.;
 bool firstMouse = true;
 
 bool debug = false;
+// G toggles between forward and deferred shading
+bool deferredShading = false;
+// B toggles between the mip-chain bloom and the 40-pass gaussian blur it replaced
+bool mipChainBloom = true;
+// C toggles the colour grading LUT
+bool colorGrading = true;
 
 Camera camera(glm::vec3(0.0f, 1.0f, 3.0f));
 
-void renderScene(Shader& shader);
-void renderCube();
-void renderPlane();
-void renderWall();
-void renderQuad();
+void renderScene(RenderQueue& queue, HiZCuller& hiz, Shader& shader, const glm::mat4& viewProjection);
+const GeometryRange& cubeGeometry();
+vector<Vertex> toVertices(const float* data, unsigned int count);
+GeometryRange uploadPrimitive(const vector<Vertex>& vertices);
 
 // texture loading
 unsigned int cubeTexture, floorTexture;
@@ -48,6 +69,26 @@ unsigned int wallTexture, wallNormal;
 unsigned int brickDiffuse, brickNormal, brickHeight;
 unsigned int woodDiffuse, toyBoxNormal, toyBoxHeight;
 
+// render queue materials
+unsigned int tunnelMaterial, cubeMaterial;
+
+// scene objects, placed once and only recomputed when moved
+struct SceneObject {
+    int node;
+    unsigned int material;
+    AABB bounds; // local space
+    bool occluder; // large enough to hide other objects
+    int proxy;
+};
+SceneGraph scene;
+vector<SceneObject> sceneObjects;
+vector<AABB> sceneWorldBounds; // per object, world space
+Bvh sceneBvh;
+OcclusionCuller occlusionCuller;
+unsigned int sceneBoundsVersion = 0;
+void buildScene();
+void updateSceneBounds();
+
 int main(void) {
     // initializing window
     // -------------------
@@ -77,6 +118,7 @@ int main(void) {
 
     // register callbacks
     glfwSetFramebufferSizeCallback(window, framebuffer_size_callback);
+    glfwGetFramebufferSize(window, &framebufferWidth, &framebufferHeight);
     glfwSetCursorPosCallback(window, mouse_callback);
     glfwSetScrollCallback(window, scroll_callback);
 
@@ -93,80 +135,57 @@ int main(void) {
 
     // shader loading
     Shader shader("./shaders/hdr_lighting.vs", "./shaders/hdr_lighting.fs");
-    Shader hdrShader("./shaders/hdr.vs", "./shaders/hdr.fs");
-    Shader bloomShader("./shaders/gaussian_blur.vs", "./shaders/gaussian_blur.fs");
-
-    unsigned int hdrFBO;
-    glGenFramebuffers(1, &hdrFBO);
-    glBindFramebuffer(GL_FRAMEBUFFER, hdrFBO);
-
-    unsigned int colorBuffers[2];
-    glGenTextures(2, colorBuffers);
-    for (unsigned int i = 0; i < 2; ++i) {
-        glBindTexture(GL_TEXTURE_2D, colorBuffers[i]);
-        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA16F, SCR_WIDTH, SCR_HEIGHT, 0, GL_RGBA, GL_FLOAT, NULL);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-        
-        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0 + i, GL_TEXTURE_2D, colorBuffers[i], 0);
-    }
-    unsigned int attachments[2] = { GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1 };
-    glDrawBuffers(2, attachments);
-
-    unsigned int rboDepth;
-    glGenRenderbuffers(1, &rboDepth);
-    glBindRenderbuffer(GL_RENDERBUFFER, rboDepth);
-    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT, SCR_WIDTH, SCR_HEIGHT);
-    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, rboDepth);
-    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
-        std::cout << "Framebuffer not complete!" << std::endl;
-    glBindFramebuffer(GL_FRAMEBUFFER, 0);
-
-    // framebuffer for bloom effect (gaussian blur)
-    unsigned int bloomFBO[2];
-    glGenFramebuffers(2, bloomFBO);
-    unsigned int bloomColorBuffers[2];
-    glGenTextures(2, bloomColorBuffers);
-    for (unsigned int i = 0; i < 2; ++i) {
-        glBindFramebuffer(GL_FRAMEBUFFER, bloomFBO[i]);
-
-        glBindTexture(GL_TEXTURE_2D, bloomColorBuffers[i]);
-        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA16F, SCR_WIDTH, SCR_HEIGHT, 0, GL_RGBA, GL_FLOAT, NULL);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-
-        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, bloomColorBuffers[i], 0);
-
-        if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
-            std::cout << "Framebuffer not complete!" << std::endl;
-    }
-    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+    // scene draws go through the queue so they can be sorted by state and depth
+    RenderQueue queue;
+    Shader depthPrepassShader("./shaders/depth_prepass.vs", "./shaders/depth_prepass.fs");
+    queue.SetDepthPrepass(&depthPrepassShader);
+    tunnelMaterial = queue.RegisterMaterial({ { woodDiffuse }, [](Shader& s) { s.setBool("inverseNormal", true); }, PrepassMode::Auto });
+    cubeMaterial = queue.RegisterMaterial({ { cubeTexture }, [](Shader& s) { s.setBool("inverseNormal", false); }, PrepassMode::Auto });
+    buildScene();
+
+    // the depth buffer stays around as a texture for the Hi-Z pyramid
+    HiZCuller hiz(framebufferWidth, framebufferHeight);
+
+    // every other render target is a transient of the graph, rebuilt each frame
+    RenderGraph graph;
+    Bloom bloomChain;
+    // the variance of the 20 horizontal and 20 vertical 9-tap passes this replaced, in one pass each
+    GaussianBlur gaussianBlur(std::sqrt(20.0f * 2.854f));
+    GpuTimer gaussianBloomTimer;
+    // nothing reads the alpha of the HDR colour, bright-pass or bloom targets, so they drop it
+    // for half the bytes of GL_RGBA16F where the packed float format renders and holds HDR values
+    const GLenum hdrColorFormat = RenderGraph::NegotiateFormat({ GL_R11F_G11F_B10F, GL_RGBA16F });
+    const GLenum bloomFormat = RenderGraph::NegotiateFormat({ GL_R11F_G11F_B10F, GL_RGBA16F });
+    bloomChain.SetFormat(bloomFormat);
+    bool timedMipChainBloom = mipChainBloom;
+    AutoExposure autoExposure;
+    // bloom combine, exposure, tone mapping and grading in one generated pass
+    PostProcess postProcess;
+    postProcess.SetGrading({
+        Grading::LiftGammaGain(glm::vec3(0.02f, 0.0f, 0.03f), glm::vec3(1.0f), glm::vec3(1.05f, 1.0f, 0.95f)),
+        Grading::Contrast(1.1f),
+        Grading::Saturation(1.15f),
+    });
 
     // lighting info
     // -------------
-    // positions
-    std::vector<glm::vec3> lightPositions;
-    lightPositions.push_back(glm::vec3(0.0f, 0.0f, 49.5f)); // back light
-    lightPositions.push_back(glm::vec3(-1.4f, -1.9f, 9.0f));
-    lightPositions.push_back(glm::vec3(0.0f, -1.8f, 4.0f));
-    lightPositions.push_back(glm::vec3(0.8f, -1.7f, 6.0f));
-    // colors
-    std::vector<glm::vec3> lightColors;
-    lightColors.push_back(glm::vec3(200.0f, 200.0f, 200.0f));
-    lightColors.push_back(glm::vec3(2.0f, 0.0f, 0.0f));
-    lightColors.push_back(glm::vec3(0.0f, 0.0f, 0.2f));
-    lightColors.push_back(glm::vec3(0.0f, 2.0f, 0.0f));
+    // positions and colors
+    std::vector<PointLight> lights;
+    lights.push_back({ glm::vec3(0.0f, 0.0f, 49.5f), glm::vec3(200.0f, 200.0f, 200.0f) }); // back light
+    lights.push_back({ glm::vec3(-1.4f, -1.9f, 9.0f), glm::vec3(2.0f, 0.0f, 0.0f) });
+    lights.push_back({ glm::vec3(0.0f, -1.8f, 4.0f), glm::vec3(0.0f, 0.0f, 0.2f) });
+    lights.push_back({ glm::vec3(0.8f, -1.7f, 6.0f), glm::vec3(0.0f, 2.0f, 0.0f) });
+    for (auto& light : lights)
+        light.radius = InfluenceRadius(light.color);
+    // lights that touch no object are left out of the cluster assignment
+    ObjectLightLists objectLights;
+    std::vector<PointLight> reachingLights;
+    ClusteredLights clusteredLights;
+    DeferredRenderer deferredRenderer;
 
     shader.use();
 
-    hdrShader.use();
-    hdrShader.setInt("hdrBuffer", 0);
-    hdrShader.setInt("bloom", 1);
-
     // render loop
     while (!glfwWindowShouldClose(window)) {
         float currentFrame = glfwGetTime();
@@ -176,59 +195,117 @@ int main(void) {
         // input
         processInput(window);
 
-        // rendering
-        // ---------
-
-        // render scene to hdr fbo
-        // ---------
-        glBindFramebuffer(GL_FRAMEBUFFER, hdrFBO);
-        glViewport(0, 0, SCR_WIDTH, SCR_HEIGHT);
-        glClearColor(0.3f, 0.3f, 0.3f, 1.0f);
-        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        // a minimised window has nothing to draw into
+        if (framebufferWidth == 0 || framebufferHeight == 0) {
+            glfwPollEvents();
+            continue;
+        }
+        int width = framebufferWidth, height = framebufferHeight;
+        hiz.Resize(width, height);
 
         glm::mat4 view = camera.GetViewMatrix();
-        glm::mat4 projection = glm::perspective(glm::radians(camera.Zoom), (float)SCR_WIDTH / (float)SCR_HEIGHT, 0.1f, 100.0f);
-
-        shader.use();
-        shader.setMat4("view", view);
-        shader.setMat4("projection", projection);
-        shader.setVec3("viewPos", camera.Position);
-        shader.setBool("inverseNormal", false);
-
-        for (int i = 0; i < lightPositions.size(); ++i) {
-            std::string lightStr = "lights[" + std::to_string(i) + "].";
-            shader.setVec3(lightStr + "position", lightPositions[i]);
-            shader.setVec3(lightStr + "color", lightColors[i]);
+        glm::mat4 projection = glm::perspective(glm::radians(camera.Zoom), (float)width / (float)height, 0.1f, 100.0f);
+
+        Shader& sceneShader = deferredShading ? deferredRenderer.GeometryShader() : shader;
+        depthPrepassShader.use();
+        depthPrepassShader.setMat4("view", view);
+        depthPrepassShader.setMat4("projection", projection);
+        sceneShader.use();
+        sceneShader.setMat4("view", view);
+        sceneShader.setMat4("projection", projection);
+        sceneShader.setVec3("viewPos", camera.Position);
+        sceneShader.setBool("inverseNormal", false);
+
+        scene.UpdateTransforms();
+        updateSceneBounds();
+
+        objectLights.Build(sceneWorldBounds, lights);
+        reachingLights.clear();
+        for (std::size_t i = 0; i < lights.size(); ++i) {
+            if (objectLights.Reaches(i))
+                reachingLights.push_back(lights[i]);
         }
+        clusteredLights.Update(view, projection, reachingLights);
+        if (!deferredShading)
+            clusteredLights.Bind(shader, 12, width, height);
 
-        renderScene(shader);
+        // rendering
+        // ---------
+        queue.BeginFrame();
+        graph.Reset(width, height);
+        const RenderTextureDesc hdrDesc = { hdrColorFormat, width, height };
+        const RenderTextureDesc bloomDesc = { bloomFormat, width, height };
+        RenderResource depth = graph.Import("depth", hiz.DepthTexture(), { GL_DEPTH_COMPONENT32F, width, height });
+        RenderResource hdrColor, bright;
+        glClearColor(0.3f, 0.3f, 0.3f, 1.0f);
 
-        // apply gaussian blur to bright-only texture
-        bloomShader.use();
-        bool horizontal = false;
-        int amount = 40;
+        // render scene to hdr targets, or to the G-buffer and light it from there
+        if (deferredShading) {
+            RenderResource albedo, normal;
+            graph.AddPass("gbuffer", [&](RenderGraph::Builder& builder) {
+                albedo = builder.Write(builder.Create("albedo", { DeferredRenderer::ALBEDO_FORMAT, width, height }));
+                normal = builder.Write(builder.Create("normal", { DeferredRenderer::NORMAL_FORMAT, width, height }));
+                builder.Write(depth);
+            }, [&](RenderGraph&) {
+                glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+                renderScene(queue, hiz, sceneShader, projection * view);
+            });
+            graph.AddPass("deferred lighting", [&](RenderGraph::Builder& builder) {
+                builder.Read(albedo);
+                builder.Read(normal);
+                builder.Read(depth);
+                hdrColor = builder.Write(builder.Create("hdr color", hdrDesc));
+                bright = builder.Write(builder.Create("bright", bloomDesc));
+            }, [&](RenderGraph& g) {
+                deferredRenderer.Light(view, projection, camera.Position, clusteredLights,
+                    g.Texture(albedo), g.Texture(normal), g.Texture(depth), width, height);
+            });
+        } else {
+            graph.AddPass("forward", [&](RenderGraph::Builder& builder) {
+                hdrColor = builder.Write(builder.Create("hdr color", hdrDesc));
+                bright = builder.Write(builder.Create("bright", bloomDesc));
+                builder.Write(depth);
+            }, [&](RenderGraph&) {
+                glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+                renderScene(queue, hiz, sceneShader, projection * view);
+            });
+        }
 
-        for (int i = 0; i < amount; ++i) {
-            glBindFramebuffer(GL_FRAMEBUFFER, bloomFBO[horizontal]);
-            glBindTexture(GL_TEXTURE_2D, i == 0 ? colorBuffers[1] : bloomColorBuffers[!horizontal]);
-            bloomShader.setBool("horizontal", horizontal);
-            renderQuad();
-            horizontal = !horizontal;
+        // blur the bright-only texture, either through the mip chain or with a wide separable gaussian
+        // at full resolution (compute on 4.3 contexts)
+        RenderResource bloom;
+        if (timedMipChainBloom != mipChainBloom) {
+            std::cout << "bloom GPU time: mip chain " << bloomChain.Milliseconds() << " ms, gaussian "
+                << gaussianBloomTimer.Milliseconds() << " ms" << std::endl;
+            timedMipChainBloom = mipChainBloom;
+        }
+        if (mipChainBloom) {
+            bloom = bloomChain.AddPasses(graph, bright);
+        } else {
+            RenderResource bloomPing;
+            graph.AddPass("gaussian bloom", [&](RenderGraph::Builder& builder) {
+                builder.Read(bright);
+                bloomPing = builder.Write(builder.Create("bloom ping", bloomDesc));
+                bloom = builder.Write(builder.Create("bloom pong", bloomDesc));
+            }, [&](RenderGraph& g) {
+                gaussianBloomTimer.Begin();
+                gaussianBlur.Blur(g, bright, bloomPing, bloom);
+                gaussianBloomTimer.End();
+            });
         }
 
-        // then render hdr color buffer to quad with tone mapping shader
-        // also merge blurred texture for the final bloom effect
-        glBindFramebuffer(GL_FRAMEBUFFER, 0);
-        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-        hdrShader.use();
-        hdrShader.setFloat("exposure", 1.0f);
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_2D, colorBuffers[0]);
-        glActiveTexture(GL_TEXTURE1);
-        glBindTexture(GL_TEXTURE_2D, bloomColorBuffers[1]);
-        glActiveTexture(GL_TEXTURE0);
+        // the exposure follows the scene's average luminance, measured on the GPU
+        RenderResource luminance = autoExposure.AddPasses(graph, hdrColor, deltaTime);
 
-        renderQuad();
+        // then merge the blurred texture for the final bloom effect and tone map, all in one pass
+        PostProcessConfig postConfig;
+        postConfig.colorGrading = colorGrading;
+        postProcess.Configure(postConfig);
+        postProcess.SetBloomStrength(mipChainBloom ? bloomChain.Normalization() : 1.0f);
+        postProcess.AddPass(graph, hdrColor, bloom, luminance);
+
+        graph.Compile();
+        graph.Execute();
 
         // check and call events and swap the buffers
         glfwSwapBuffers(window);
@@ -239,101 +316,91 @@ int main(void) {
     return 0;
 }
 
-void renderScene(Shader& shader) {
-    glm::mat4 model;
+void buildScene() {
+    const AABB cubeBounds = { glm::vec3(-0.5f), glm::vec3(0.5f) };
 
-    // draw tunnel 
-    glBindTexture(GL_TEXTURE_2D, woodDiffuse);
-    model = glm::mat4(1.0f);
-    model = glm::translate(model, glm::vec3(0.0f, 0.0f, 25.0f));
-    model = glm::scale(model, glm::vec3(5.0f, 5.0f, 50.0f));
-    shader.setBool("inverseNormal", true);
-    shader.setMat4("model", model);
-    renderCube();
-    shader.setBool("inverseNormal", false);
+    // tunnel
+    int tunnel = scene.CreateNode(-1, "tunnel");
+    scene.SetPosition(tunnel, glm::vec3(0.0f, 0.0f, 25.0f));
+    scene.SetScale(tunnel, glm::vec3(5.0f, 5.0f, 50.0f));
+    sceneObjects.push_back({ tunnel, tunnelMaterial, cubeBounds, true, Bvh::NONE });
 
     // ---- cubes ----
-    glBindTexture(GL_TEXTURE_2D, cubeTexture);
-    model = glm::mat4(1.0f);
-    model = glm::translate(model, glm::vec3(-1.0f, -2.0f, 10.0f));
-    shader.setMat4("model", model);
-    renderCube();
-
-    model = glm::mat4(1.0f);
-    model = glm::translate(model, glm::vec3(0.0f, -2.0f, 5.0f));
-    model = glm::rotate(model, glm::radians(30.0f), glm::vec3(0.0f, 2.0f, 0.0f));
-    shader.setMat4("model", model);
-    renderCube();
+    int cube = scene.CreateNode(-1, "cube0");
+    scene.SetPosition(cube, glm::vec3(-1.0f, -2.0f, 10.0f));
+    sceneObjects.push_back({ cube, cubeMaterial, cubeBounds, true, Bvh::NONE });
+
+    cube = scene.CreateNode(-1, "cube1");
+    scene.SetPosition(cube, glm::vec3(0.0f, -2.0f, 5.0f));
+    scene.SetRotation(cube, glm::angleAxis(glm::radians(30.0f), glm::vec3(0.0f, 1.0f, 0.0f)));
+    sceneObjects.push_back({ cube, cubeMaterial, cubeBounds, true, Bvh::NONE });
+
+    scene.UpdateTransforms();
+    sceneWorldBounds.resize(sceneObjects.size());
+    for (unsigned int i = 0; i < sceneObjects.size(); ++i) {
+        SceneObject& object = sceneObjects[i];
+        sceneWorldBounds[i] = AABB::Transform(object.bounds, scene.World(object.node));
+        object.proxy = sceneBvh.Insert(sceneWorldBounds[i], i);
+    }
+    sceneBoundsVersion = scene.Version();
 }
 
-void renderWall() {
-    static unsigned int wallVAO = 0, wallVBO = 0;
-
-    if (wallVAO == 0) {
-        // hande calculation of TBN matrix
-        // edge1 = pos1 - pos3 = (u1 - u3) * T + (v1 - v3) * B
-        // edge2 = pos1 - pos2 = (u1 - u2) * T + (v1 - v2) * B
-        // rewrite in matrix multiplication
-        // | e1 | = | du1 dv1 | * | T |
-        // | e2 |   | du2 dv2 |   | B |
-        //  =>
-        // | T | = | du1 dv1 | ^ -1  * | e1 |
-        // | B |   | du2 dv2 |         | e2 |
-        //       = 1 /                     * | dv2  -dv1 | * | e1 |
-        //         (du1 * dv2 - dv1 * du2)   | -du2  du1 | * | e2 |
-        glm::vec3 pos1(-1.0, -1.0, 0.0);
-        glm::vec3 pos2(1.0, -1.0, 0.0);
-        glm::vec3 pos3(1.0, 1.0, 0.0);
-        glm::vec3 pos4(-1.0, 1.0, 0.0);
-        glm::vec2 uv1(0.0, 0.0);
-        glm::vec2 uv2(1.0, 0.0);
-        glm::vec2 uv3(1.0, 1.0);
-        glm::vec2 uv4(0.0, 1.0);
-
-        glm::vec3 ed1 = pos1 - pos3;
-        glm::vec3 ed2 = pos1 - pos2;
-        glm::vec2 deltaUV1 = uv1 - uv3;
-        glm::vec2 deltaUV2 = uv1 - uv2;
-        float f = 1.0 / (deltaUV1.x * deltaUV2.y - deltaUV1.y * deltaUV2.x);
-
-        glm::vec3 T, B, N(0.0, 0.0, 1.0);
-        T.x = f * (deltaUV2.y * ed1.x - deltaUV1.y * ed2.x);
-        T.y = f * (deltaUV2.y * ed1.y - deltaUV1.y * ed2.y);
-        T.z = f * (deltaUV2.y * ed1.z - deltaUV1.y * ed2.z);
-
-        const static float wallVertices[] = {
-            // positions         // normal         // texture  // T           
-            -1.0f, -1.0f, 0.f,  0.0f,  0.0f, 1.0f, 0.0f, 0.0f, T.x, T.y, T.z,
-             1.0f, -1.0f, 0.f,  0.0f,  0.0f, 1.0f, 1.0f, 0.0f, T.x, T.y, T.z,
-             1.0f,  1.0f, 0.f,  0.0f,  0.0f, 1.0f, 1.0f, 1.0f, T.x, T.y, T.z,
-             1.0f,  1.0f, 0.f,  0.0f,  0.0f, 1.0f, 1.0f, 1.0f, T.x, T.y, T.z,
-            -1.0f,  1.0f, 0.f,  0.0f,  0.0f, 1.0f, 0.0f, 1.0f, T.x, T.y, T.z,
-            -1.0f, -1.0f, 0.f,  0.0f,  0.0f, 1.0f, 0.0f, 0.0f, T.x, T.y, T.z,
-        };
-
-        glGenVertexArrays(1, &wallVAO);
-        glGenBuffers(1, &wallVBO);
-        glBindVertexArray(wallVAO);
-        glBindBuffer(GL_ARRAY_BUFFER, wallVBO);
-        glBufferData(GL_ARRAY_BUFFER, sizeof(wallVertices), &wallVertices, GL_STATIC_DRAW);
-        glEnableVertexAttribArray(0);
-        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 11 * sizeof(float), (void*)0);
-        glEnableVertexAttribArray(1);
-        glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 11 * sizeof(float), (void*)(3 * sizeof(float)));
-        glEnableVertexAttribArray(2);
-        glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, 11 * sizeof(float), (void*)(6 * sizeof(float)));
-        glEnableVertexAttribArray(3);
-        glVertexAttribPointer(3, 3, GL_FLOAT, GL_FALSE, 11 * sizeof(float), (void*)(8 * sizeof(float)));
-        glBindVertexArray(0);
+// moves the culling bounds of every object after the scene graph changed
+void updateSceneBounds() {
+    if (scene.Version() == sceneBoundsVersion)
+        return;
+    for (unsigned int i = 0; i < sceneObjects.size(); ++i) {
+        const SceneObject& object = sceneObjects[i];
+        sceneWorldBounds[i] = AABB::Transform(object.bounds, scene.World(object.node));
+        sceneBvh.Move(object.proxy, sceneWorldBounds[i]);
     }
+    sceneBoundsVersion = scene.Version();
+}
 
-
-    glBindVertexArray(wallVAO);
-    glDrawArrays(GL_TRIANGLES, 0, 6);
+// only objects whose bounds touch the view frustum and are not hidden behind an occluder are considered.
+// of those, the ones the GPU saw last frame are drawn first, the rest are retested against their depth.
+void renderScene(RenderQueue& queue, HiZCuller& hiz, Shader& shader, const glm::mat4& viewProjection) {
+    static vector<unsigned int> visible, retest;
+    visible.clear();
+    retest.clear();
+    sceneBvh.QueryFrustum(Frustum::FromMatrix(viewProjection), visible);
+
+    occlusionCuller.Begin(viewProjection);
+    for (unsigned int index : visible) {
+        const SceneObject& object = sceneObjects[index];
+        if (object.occluder)
+            occlusionCuller.AddOccluderBox(object.bounds, scene.World(object.node));
+    }
+    occlusionCuller.Render();
+
+    hiz.Begin(sceneWorldBounds);
+    queue.Begin(camera.Position, 100.0f);
+    for (unsigned int index : visible) {
+        const SceneObject& object = sceneObjects[index];
+        if (!occlusionCuller.IsVisible(sceneWorldBounds[index]))
+            continue;
+        if (!hiz.WasVisible(index)) {
+            retest.push_back(index);
+            continue;
+        }
+        queue.Submit(RenderPass::Opaque, shader, object.material, Mesh::Heap(), cubeGeometry(), scene.World(object.node));
+    }
+    queue.Flush();
+
+    // newly visible objects are drawn this frame, the GPU drops the ones whose query failed
+    hiz.BuildPyramid();
+    hiz.Test(viewProjection, retest);
+    queue.Begin(camera.Position, 100.0f);
+    for (unsigned int index : retest) {
+        const SceneObject& object = sceneObjects[index];
+        queue.Submit(RenderPass::Opaque, shader, object.material, Mesh::Heap(), cubeGeometry(), scene.World(object.node),
+            GL_TRIANGLES, hiz.Query(index));
+    }
+    queue.Flush();
 }
 
-void renderCube() {
-    static unsigned int cubeVAO = 0, cubeVBO = 0;
+const GeometryRange& cubeGeometry() {
+    static GeometryRange cubeRange;
     const static float cubeVertices[] = {
         // positions         // normal           // texture Coords
         -0.5f, -0.5f, -0.5f,  0.0f,  0.0f, -1.0f, 0.0f, 0.0f,
@@ -379,88 +446,35 @@ void renderCube() {
         -0.5f,  0.5f,  0.5f,  0.0f,  1.0f,  0.0f, 0.0f, 0.0f,
     };
 
-    if (cubeVAO == 0) {
-        // cube VAO
-        glGenVertexArrays(1, &cubeVAO);
-        glGenBuffers(1, &cubeVBO);
-        glBindVertexArray(cubeVAO);
-        glBindBuffer(GL_ARRAY_BUFFER, cubeVBO);
-        glBufferData(GL_ARRAY_BUFFER, sizeof(cubeVertices), &cubeVertices, GL_STATIC_DRAW);
-        glEnableVertexAttribArray(0);
-        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)0);
-        glEnableVertexAttribArray(1);
-        glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(3 * sizeof(float)));
-        glEnableVertexAttribArray(2);
-        glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(6 * sizeof(float)));
-        glBindVertexArray(0);
+    if (cubeRange.indexCount == 0) {
+        cubeRange = uploadPrimitive(toVertices(cubeVertices, 36));
     }
-
-    glBindVertexArray(cubeVAO);
-    glDrawArrays(GL_TRIANGLES, 0, 36);
+    return cubeRange;
 }
 
-void renderPlane() {
-    static  unsigned int planeVAO = 0, planeVBO = 0;
-
-    static const float planeVertices[] = {
-        // positions          // normal      // texture Coords (note we set these higher than 1 (together with GL_REPEAT as texture wrapping mode). this will cause the floor texture to repeat)
-         15.0f, -0.51f, 15.0f, 0.0, 1.0, 0.0, 2.0f, 0.0f,
-        -15.0f, -0.51f, -5.0f, 0.0, 1.0, 0.0, 0.0f, 2.0f,
-        -15.0f, -0.51f, 15.0f, 0.0, 1.0, 0.0, 0.0f, 0.0f,
-
-         15.0f, -0.51f, 15.0f, 0.0, 1.0, 0.0, 2.0f, 0.0f,
-         15.0f, -0.51f, -5.0f, 0.0, 1.0, 0.0, 2.0f, 2.0f,
-        -15.0f, -0.51f, -5.0f, 0.0, 1.0, 0.0, 0.0f, 2.0f,
-    };
-
-    if (planeVAO == 0) {
-        glGenVertexArrays(1, &planeVAO);
-        glGenBuffers(1, &planeVBO);
-        glBindVertexArray(planeVAO);
-        glBindBuffer(GL_ARRAY_BUFFER, planeVBO);
-        glBufferData(GL_ARRAY_BUFFER, sizeof(planeVertices), &planeVertices, GL_STATIC_DRAW);
-        glEnableVertexAttribArray(0);
-        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)0);
-        glEnableVertexAttribArray(1);
-        glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(3 * sizeof(float)));
-        glEnableVertexAttribArray(2);
-        glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(6 * sizeof(float)));
-        glBindVertexArray(0);
+// converts interleaved position/normal/texcoord data to the shared Vertex layout
+vector<Vertex> toVertices(const float* data, unsigned int count) {
+    vector<Vertex> vertices(count);
+    for (unsigned int i = 0; i < count; ++i) {
+        const float* v = data + i * 8;
+        vertices[i].Position = glm::vec3(v[0], v[1], v[2]);
+        vertices[i].Normal = glm::vec3(v[3], v[4], v[5]);
+        vertices[i].TexCoords = glm::vec2(v[6], v[7]);
     }
-
-    glBindVertexArray(planeVAO);
-    glDrawArrays(GL_TRIANGLES, 0, 6);
+    return vertices;
 }
 
-void renderQuad() {
-    static unsigned int quadVAO = 0, quadVBO = 0;
-
-    static const float quadVertices[] = {
-        -1.,  1., 0., 0., 1.,
-        -1., -1., 0., 0., 0.,
-         1.,  1., 0., 1., 1.,
-         1., -1., 0., 1., 0.,
-    };
-
-    if (quadVAO == 0) {
-        glGenVertexArrays(1, &quadVAO);
-        glGenBuffers(1, &quadVBO);
-        glBindVertexArray(quadVAO);
-        glBindBuffer(GL_ARRAY_BUFFER, quadVBO);
-        glBufferData(GL_ARRAY_BUFFER, sizeof(quadVertices), &quadVertices, GL_STATIC_DRAW);
-        glEnableVertexAttribArray(0);
-        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void*)0);
-        glEnableVertexAttribArray(1);
-        glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void*)(3 * sizeof(float)));
-        glBindVertexArray(0);
-    }
-
-    glBindVertexArray(quadVAO);
-    glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+// places non-indexed primitive data in the shared mesh heap, so primitives and models share one VAO
+GeometryRange uploadPrimitive(const vector<Vertex>& vertices) {
+    vector<unsigned int> indices(vertices.size());
+    std::iota(indices.begin(), indices.end(), 0);
+    return Mesh::Heap().Allocate(vertices.data(), (unsigned int)vertices.size(), indices.data(), (unsigned int)indices.size());
 }
 
 void framebuffer_size_callback(GLFWwindow* window, int width, int height) {
-    glViewport(0, 0, width, height);
+    // the render graph picks the new size up on the next frame
+    framebufferWidth = width;
+    framebufferHeight = height;
 }
 
 void processInput(GLFWwindow* window) {
@@ -482,6 +496,24 @@ void processInput(GLFWwindow* window) {
     }
 
     debug = (glfwGetKey(window, GLFW_KEY_Q) == GLFW_PRESS);
+
+    static bool shadingKeyDown = false;
+    bool shadingKey = glfwGetKey(window, GLFW_KEY_G) == GLFW_PRESS;
+    if (shadingKey && !shadingKeyDown)
+        deferredShading = !deferredShading;
+    shadingKeyDown = shadingKey;
+
+    static bool bloomKeyDown = false;
+    bool bloomKey = glfwGetKey(window, GLFW_KEY_B) == GLFW_PRESS;
+    if (bloomKey && !bloomKeyDown)
+        mipChainBloom = !mipChainBloom;
+    bloomKeyDown = bloomKey;
+
+    static bool gradingKeyDown = false;
+    bool gradingKey = glfwGetKey(window, GLFW_KEY_C) == GLFW_PRESS;
+    if (gradingKey && !gradingKeyDown)
+        colorGrading = !colorGrading;
+    gradingKeyDown = gradingKey;
 }
 
 void mouse_callback(GLFWwindow* window, double xpos, double ypos)
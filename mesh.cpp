@@ -2,48 +2,115 @@
 
 #include <glad/glad.h>
 
+#include <cstddef>
+
 using std::vector;
 using std::string;
 
-Mesh::Mesh(vector<Vertex> vertices, vector<unsigned int> indices, vector<Texture> textures) {
-	this->vertices = std::move(vertices);
-	this->indices =  std::move(indices);
+Mesh::Mesh(std::span<const Vertex> vertices, std::span<const unsigned int> indices, vector<Texture> textures, MeshResidency residency) {
 	this->textures = std::move(textures);
+	resident = false;
+
+	setupMesh(vertices, indices);
+	if (residency == MeshResidency::Keep) {
+		this->vertices.assign(vertices.begin(), vertices.end());
+		this->indices.assign(indices.begin(), indices.end());
+		resident = true;
+	}
+}
+
+Mesh::~Mesh() {
+	Heap().Free(range);
+}
+
+Mesh::Mesh(Mesh&& other) noexcept
+	: textures(std::move(other.textures)), vertices(std::move(other.vertices)), indices(std::move(other.indices)),
+	resident(other.resident), range(other.range) {
+	// an empty range frees nothing
+	other.range = GeometryRange();
+}
+
+Mesh& Mesh::operator=(Mesh&& other) noexcept {
+	if (this != &other) {
+		Heap().Free(range);
+		textures = std::move(other.textures);
+		vertices = std::move(other.vertices);
+		indices = std::move(other.indices);
+		resident = other.resident;
+		range = other.range;
+		other.range = GeometryRange();
+	}
+	return *this;
+}
+
+GeometryHeap& Mesh::Heap() {
+	static GeometryHeap heap({ sizeof(Vertex), {
+		{ 0, 3, GL_FLOAT, offsetof(Vertex, Position) },  // vertex positions
+		{ 1, 3, GL_FLOAT, offsetof(Vertex, Normal) },    // vertex normals
+		{ 2, 2, GL_FLOAT, offsetof(Vertex, TexCoords) }, // vertex texture coords
+		{ 3, 3, GL_FLOAT, offsetof(Vertex, Tangent) },   // vertex tangents
+	} }, 1 << 16, 1 << 18, Instances().GetBuffer(), InstanceBuffer::Format());
+	return heap;
+}
+
+InstanceBuffer& Mesh::Instances() {
+	static InstanceBuffer instances(1 << 14);
+	return instances;
+}
+
+void Mesh::setupMesh(std::span<const Vertex> vertices, std::span<const unsigned int> indices) {
+	range = Heap().Allocate(vertices.data(), (unsigned int)vertices.size(), indices.data(), (unsigned int)indices.size());
+}
+
+void Mesh::Release() {
+	vector<Vertex>().swap(vertices);
+	vector<unsigned int>().swap(indices);
+	resident = false;
+}
+
+void Mesh::materialize() {
+	if (resident)
+		return;
+
+	vertices.resize(range.vertexCount);
+	indices.resize(range.indexCount);
+	Heap().Read(range, vertices.data(), indices.data());
+	resident = true;
+}
+
+const vector<Vertex>& Mesh::Vertices() {
+	materialize();
+	return vertices;
+}
 
-	setupMesh();
+const vector<unsigned int>& Mesh::Indices() {
+	materialize();
+	return indices;
 }
 
-void Mesh::setupMesh() {
-	glGenVertexArrays(1, &VAO);
-	glGenBuffers(1, &VBO);
-	glGenBuffers(1, &EBO);
-
-	glBindVertexArray(VAO);
-	glBindBuffer(GL_ARRAY_BUFFER, VBO);
-
-	glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(Vertex), &vertices[0], GL_STATIC_DRAW);
-
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
-	glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int),
-		&indices[0], GL_STATIC_DRAW);
-
-	// vertex positions
-	glEnableVertexAttribArray(0);
-	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)0);
-	// vertex normals
-	glEnableVertexAttribArray(1);
-	glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Normal));
-	// vertex texture coords
-	glEnableVertexAttribArray(2);
-	glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, TexCoords));
-	// vertex tangents
-	glEnableVertexAttribArray(3);
-	glVertexAttribPointer(3, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Tangent));
-
-	glBindVertexArray(0);
+void Mesh::Draw(Shader& shader, const glm::mat4& transform) {
+	BindTextures(shader);
+
+	// draw mesh as a single instance
+	GLuint baseInstance = Instances().Upload(std::span<const glm::mat4>(&transform, 1));
+	Heap().DrawInstanced(range, 1, baseInstance);
+}
+
+bool Mesh::SameTextures(const Mesh& other) const {
+	if (textures.size() != other.textures.size())
+		return false;
+	for (unsigned int i = 0; i < textures.size(); i++) {
+		if (textures[i].id != other.textures[i].id || textures[i].type != other.textures[i].type)
+			return false;
+	}
+	return true;
+}
+
+void Mesh::BindTextures(Shader& shader) {
+	BindMeshTextures(shader, textures);
 }
 
-void Mesh::Draw(Shader& shader) {
+void BindMeshTextures(Shader& shader, const vector<Texture>& textures) {
 	unsigned int diffuseNr = 1;
 	unsigned int specularNr = 1;
 	unsigned int normalNr = 1;
@@ -63,9 +130,4 @@ void Mesh::Draw(Shader& shader) {
 		glBindTexture(GL_TEXTURE_2D, textures[i].id);
 	}
 	glActiveTexture(GL_TEXTURE0);
-
-	// draw mesh
-	glBindVertexArray(VAO);
-	glDrawElements(GL_TRIANGLES, indices.size(), GL_UNSIGNED_INT, 0);
-	glBindVertexArray(0);
 }
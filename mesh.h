@@ -4,7 +4,10 @@
 #include <glm/glm.hpp>
 
 #include "shader.h"
+#include "geometry_heap.h"
+#include "instance_buffer.h"
 
+#include <span>
 #include <string>
 #include <vector>
 
@@ -21,20 +24,58 @@ struct Texture {
     std::string path;
 };
 
+// binds textures to consecutive units and points the texture_diffuseN/specularN/normalN samplers at them
+void BindMeshTextures(Shader& shader, const std::vector<Texture>& textures);
+
+// what happens to the CPU copy of the geometry once it has been uploaded
+enum class MeshResidency {
+    Release, // free it, read it back from the GPU if asked for later
+    Keep     // keep it around, e.g. for picking or physics
+};
+
 class Mesh {
 public:
     // mesh data
-    std::vector<Vertex> vertices;
-    std::vector<unsigned int> indices;
     std::vector<Texture> textures;
 
-    Mesh(std::vector<Vertex> vertices, std::vector<unsigned int> indices, std::vector<Texture> textures);
-    void Draw(Shader& shader);
+    // the geometry is uploaded right away and only copied if it has to stay resident
+    Mesh(std::span<const Vertex> vertices, std::span<const unsigned int> indices, std::vector<Texture> textures,
+        MeshResidency residency = MeshResidency::Release);
+    // returns the geometry to the heap. meshes own their range, so they move but don't copy
+    ~Mesh();
+    Mesh(const Mesh&) = delete;
+    Mesh& operator=(const Mesh&) = delete;
+    Mesh(Mesh&& other) noexcept;
+    Mesh& operator=(Mesh&& other) noexcept;
+
+    // the shader reads the model matrix from the instance stream, so the transform goes through it too
+    void Draw(Shader& shader, const glm::mat4& transform = glm::mat4(1.0f));
+    // binds the mesh textures to consecutive units and points the sampler uniforms at them
+    void BindTextures(Shader& shader);
+    bool SameTextures(const Mesh& other) const;
+    const GeometryRange& Range() const { return range; }
+
+    // CPU-side geometry, read back from the heap first if it was released
+    const std::vector<Vertex>& Vertices();
+    const std::vector<unsigned int>& Indices();
+    bool IsResident() const { return resident; }
+    // frees the CPU copy; the GPU copy stays drawable
+    void Release();
+
+    // shared heap holding the geometry of every mesh using the Vertex layout
+    static GeometryHeap& Heap();
+    // per-instance transform stream bound to the heap's VAO
+    static InstanceBuffer& Instances();
 private:
+    std::vector<Vertex> vertices;
+    std::vector<unsigned int> indices;
+    bool resident;
+
     // render data
-    unsigned int VAO, VBO, EBO;
+    GeometryRange range;
 
-    void setupMesh();
+    void setupMesh(std::span<const Vertex> vertices, std::span<const unsigned int> indices);
+    void materialize();
 };
 
 #endif
@@ -1,7 +1,10 @@
 #include "model.h"
 #include "stb_image.h"
 
+#include <cstddef>
+#include <cstring>
 #include <iostream>
+#include <memory>
 #include <vector>
 
 using std::string;
@@ -9,9 +12,126 @@ using std::cout;
 using std::endl;
 using std::vector;
 
-void Model::Draw(Shader& shader) {
+// assimp matrices are row-major, glm is column-major
+glm::mat4 AssimpToGlm(const aiMatrix4x4& m) {
+	return glm::mat4(
+		glm::vec4(m.a1, m.b1, m.c1, m.d1),
+		glm::vec4(m.a2, m.b2, m.c2, m.d2),
+		glm::vec4(m.a3, m.b3, m.c3, m.d3),
+		glm::vec4(m.a4, m.b4, m.c4, m.d4));
+}
+
+glm::mat4 Model::meshTransform(unsigned int mesh, const glm::mat4& transform) const {
+	int node = meshNodes[mesh];
+	return node < 0 ? transform : transform * nodes.World(node);
+}
+
+void Model::Draw(Shader& shader, const glm::mat4& transform) {
+	nodes.UpdateTransforms();
+
+	// one transform per draw, in the same order as the commands
+	drawTransforms.clear();
+	for (const auto& batch : batches) {
+		for (unsigned int meshIndex : batch.meshIndices)
+			drawTransforms.push_back(meshTransform(meshIndex, transform));
+	}
+	GLuint baseInstance = Mesh::Instances().Upload(drawTransforms);
+
+	GeometryHeap& heap = Mesh::Heap();
+	if (indirectBuffer)
+		glBindBuffer(GL_DRAW_INDIRECT_BUFFER, indirectBuffer);
+
+	for (const auto& batch : batches) {
+		meshes[batch.textureMesh].BindTextures(shader);
+		GLuint firstInstance = baseInstance + batch.firstDraw;
+		if (indirectBuffer) {
+			// the commands' base instances are fixed, the heap moves the instance attributes to this upload
+			heap.MultiDrawIndirect(batch.indirectOffset, batch.drawCount, baseInstance);
+			continue;
+		}
+
+		// without base instance a multi-draw reads one transform for all of its draws
+		bool sharedTransform = true;
+		for (GLsizei i = 1; i < batch.drawCount && sharedTransform; i++)
+			sharedTransform = drawTransforms[batch.firstDraw + i] == drawTransforms[batch.firstDraw];
+		if (sharedTransform) {
+			heap.MultiDraw(batch.counts.data(), batch.offsets.data(), batch.baseVertices.data(), batch.drawCount, firstInstance);
+		} else {
+			for (GLsizei i = 0; i < batch.drawCount; i++)
+				heap.DrawInstanced(meshes[batch.meshIndices[i]].Range(), 1, firstInstance + i);
+		}
+	}
+
+	if (indirectBuffer)
+		glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+}
+
+void Model::DrawInstanced(Shader& shader, std::span<const glm::mat4> models) {
+	if (models.empty())
+		return;
+	nodes.UpdateTransforms();
+
+	// one block of instance transforms per mesh, each placed by its node
+	drawTransforms.clear();
+	for (const auto& batch : batches) {
+		for (unsigned int meshIndex : batch.meshIndices) {
+			for (const auto& model : models)
+				drawTransforms.push_back(meshTransform(meshIndex, model));
+		}
+	}
+	GLuint baseInstance = Mesh::Instances().Upload(drawTransforms);
+
+	for (const auto& batch : batches) {
+		meshes[batch.textureMesh].BindTextures(shader);
+		for (unsigned int meshIndex : batch.meshIndices) {
+			Mesh::Heap().DrawInstanced(meshes[meshIndex].Range(), (GLsizei)models.size(), baseInstance);
+			baseInstance += (GLuint)models.size();
+		}
+	}
+}
+
+void Model::buildDrawBatches() {
+	// group meshes by texture set, keeping the order in which sets first appear
+	vector<vector<unsigned int>> groups;
 	for (unsigned int i = 0; i < meshes.size(); i++) {
-		meshes[i].Draw(shader);
+		bool found = false;
+		for (auto& group : groups) {
+			if (meshes[group[0]].SameTextures(meshes[i])) {
+				group.push_back(i);
+				found = true;
+				break;
+			}
+		}
+		if (!found) groups.push_back({ i });
+	}
+
+	// draw i reads transform i of the upload, so the commands never change
+	vector<DrawElementsIndirectCommand> commands;
+	for (const auto& group : groups) {
+		DrawBatch batch;
+		batch.textureMesh = group[0];
+		batch.drawCount = (GLsizei)group.size();
+		batch.firstDraw = (GLuint)commands.size();
+		batch.indirectOffset = commands.size() * sizeof(DrawElementsIndirectCommand);
+		batch.meshIndices = group;
+
+		for (unsigned int meshIndex : group) {
+			const GeometryRange& range = meshes[meshIndex].Range();
+			commands.push_back({ range.indexCount, 1, range.firstIndex, range.baseVertex, (GLuint)commands.size() });
+
+			batch.counts.push_back((GLsizei)range.indexCount);
+			batch.offsets.push_back(range.IndexOffset());
+			batch.baseVertices.push_back(range.baseVertex);
+		}
+		batches.push_back(std::move(batch));
+	}
+
+	// indirect draws are core since 4.3, older contexts keep the client-side arrays
+	if (GLAD_GL_VERSION_4_3 && !commands.empty()) {
+		glGenBuffers(1, &indirectBuffer);
+		glBindBuffer(GL_DRAW_INDIRECT_BUFFER, indirectBuffer);
+		glBufferData(GL_DRAW_INDIRECT_BUFFER, commands.size() * sizeof(DrawElementsIndirectCommand), commands.data(), GL_STATIC_DRAW);
+		glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
 	}
 }
 
@@ -21,29 +141,136 @@ void Model::loadModel(string path) {
 
 	if (!scene || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE || !scene->mRootNode) {
 		cout << "ERROR::ASSIMP::" << import.GetErrorString() << endl;
+		return;
 	}
 	directory = path.substr(0, path.find_last_of('/'));
 
-	processNode(scene->mRootNode, scene);
+	// every import temporary comes from one arena sized for the whole scene up front,
+	// it is dropped as a whole once the geometry is on the GPU
+	std::map<unsigned int, std::pair<std::size_t, std::size_t>> materialSizes;
+	std::size_t arenaSize = measureGeometry(scene->mRootNode, scene, materialSizes);
+	std::unique_ptr<std::byte[]> arenaBuffer(new std::byte[arenaSize]);
+	std::pmr::monotonic_buffer_resource arena(arenaBuffer.get(), arenaSize);
+	importResource = &arena;
+
+	if (options.staticBatching) {
+		for (const auto& [materialIndex, sizes] : materialSizes) {
+			MergedGeometry& merged = mergedGeometry.emplace(materialIndex, MergedGeometry(importResource)).first->second;
+			merged.vertices.reserve(sizes.first);
+			merged.indices.reserve(sizes.second);
+		}
+	}
+
+	processNode(scene->mRootNode, scene, -1, glm::mat4(1.0f));
+	if (options.staticBatching)
+		buildMergedMeshes(scene);
+	buildDrawBatches();
+	nodes.UpdateTransforms();
+
+	importResource = nullptr;
 }
 
-void Model::processNode(aiNode* node, const aiScene* scene) {
+std::size_t Model::measureGeometry(const aiNode* node, const aiScene* scene, std::map<unsigned int, std::pair<std::size_t, std::size_t>>& materialSizes) {
+	std::size_t bytes = 0;
+	for (unsigned int i = 0; i < node->mNumMeshes; i++) {
+		const aiMesh* mesh = scene->mMeshes[node->mMeshes[i]];
+		std::size_t indexCount = (std::size_t)mesh->mNumFaces * 3; // triangulated
+		// room for the vertex and index arrays plus their alignment padding
+		bytes += mesh->mNumVertices * sizeof(Vertex) + indexCount * sizeof(unsigned int) + 2 * alignof(std::max_align_t);
+
+		auto& sizes = materialSizes[mesh->mMaterialIndex];
+		sizes.first += mesh->mNumVertices;
+		sizes.second += indexCount;
+	}
+	for (unsigned int i = 0; i < node->mNumChildren; i++) {
+		bytes += measureGeometry(node->mChildren[i], scene, materialSizes);
+	}
+	return bytes;
+}
+
+void Model::processNode(aiNode* node, const aiScene* scene, int parentNode, const glm::mat4& parentTransform) {
+	glm::mat4 local = AssimpToGlm(node->mTransformation);
+	glm::mat4 transform = parentTransform * local;
+	int nodeIndex = nodes.CreateNode(parentNode, node->mName.C_Str());
+	nodes.SetLocalMatrix(nodeIndex, local);
+
 	// process all the node's meshes (if any)
 	for (unsigned int i = 0; i < node->mNumMeshes; i++) {
-		aiMesh* mesh = scene->mMeshes[node->mMeshes[i]];
-		meshes.push_back(processMesh(mesh, scene));
+		if (options.staticBatching) {
+			mergeMesh(node->mMeshes[i], node, scene, transform);
+		} else {
+			aiMesh* mesh = scene->mMeshes[node->mMeshes[i]];
+			meshes.push_back(processMesh(mesh, scene));
+			meshNodes.push_back(nodeIndex);
+		}
 	}
 	// then do the same for each of its children
 	for (unsigned int i = 0; i < node->mNumChildren; i++) {
-		processNode(node->mChildren[i], scene);
+		processNode(node->mChildren[i], scene, nodeIndex, transform);
 	}
 }
 
 Mesh Model::processMesh(aiMesh* mesh, const aiScene* scene) {
-	vector<Vertex> vertices;
-	vector<unsigned int> indices;
-	vector<Texture> textures;
+	std::pmr::vector<Vertex> vertices(importResource);
+	std::pmr::vector<unsigned int> indices(importResource);
+	vertices.reserve(mesh->mNumVertices);
+	indices.reserve((std::size_t)mesh->mNumFaces * 3);
+	ReadMeshGeometry(mesh, vertices, indices);
+
+	return Mesh(vertices, indices, loadMeshTextures(mesh, scene), options.residency);
+}
+
+void Model::mergeMesh(unsigned int meshIndex, const aiNode* node, const aiScene* scene, const glm::mat4& transform) {
+	aiMesh* mesh = scene->mMeshes[meshIndex];
+	// reserved up front in loadModel, so appending never reallocates
+	MergedGeometry& merged = mergedGeometry.at(mesh->mMaterialIndex);
+	std::size_t firstVertex = merged.vertices.size();
+	std::size_t firstIndex = merged.indices.size();
+	ReadMeshGeometry(mesh, merged.vertices, merged.indices);
 
+	BakeTransform(std::span<Vertex>(merged.vertices).subspan(firstVertex), transform);
+	for (std::size_t i = firstIndex; i < merged.indices.size(); i++) {
+		merged.indices[i] += (unsigned int)firstVertex;
+	}
+
+	SubMesh subMesh;
+	subMesh.mesh = 0; // assigned once the merged meshes are created
+	subMesh.firstIndex = (unsigned int)firstIndex;
+	subMesh.indexCount = (unsigned int)(merged.indices.size() - firstIndex);
+	subMesh.sourceMesh = meshIndex;
+	subMesh.node = node->mName.C_Str();
+	merged.subMeshes.push_back(subMesh);
+}
+
+void Model::buildMergedMeshes(const aiScene* scene) {
+	for (auto& [materialIndex, merged] : mergedGeometry) {
+		if (merged.subMeshes.empty())
+			continue;
+		// every mesh in the group shares the material, load its textures through the first one
+		aiMesh* first = scene->mMeshes[merged.subMeshes[0].sourceMesh];
+		unsigned int meshIndex = (unsigned int)meshes.size();
+		meshes.push_back(Mesh(merged.vertices, merged.indices, loadMeshTextures(first, scene), options.residency));
+		meshNodes.push_back(-1);
+
+		for (auto& subMesh : merged.subMeshes) {
+			subMesh.mesh = meshIndex;
+			subMeshes.push_back(subMesh);
+		}
+	}
+	mergedGeometry.clear();
+}
+
+void BakeTransform(std::span<Vertex> vertices, const glm::mat4& transform) {
+	glm::mat3 linear = glm::mat3(transform);
+	glm::mat3 normalMatrix = glm::transpose(glm::inverse(linear));
+	for (Vertex& vertex : vertices) {
+		vertex.Position = glm::vec3(transform * glm::vec4(vertex.Position, 1.0f));
+		vertex.Normal = glm::normalize(normalMatrix * vertex.Normal);
+		vertex.Tangent = linear * vertex.Tangent;
+	}
+}
+
+void ReadMeshGeometry(const aiMesh* mesh, std::pmr::vector<Vertex>& vertices, std::pmr::vector<unsigned int>& indices) {
 	for (unsigned int i = 0; i < mesh->mNumVertices; i++) {
 		Vertex vertex;
 		// process vertex positions, normals and texture coordinates
@@ -65,37 +292,23 @@ Mesh Model::processMesh(aiMesh* mesh, const aiScene* scene) {
 			vertex.TexCoords = glm::vec2(0.0f, 0.0f);
 		}
 
-		vertices.push_back(std::move(vertex));
+		vertices.push_back(vertex);
 	}
 	// process indices
 	for (unsigned int i = 0; i < mesh->mNumFaces; i++) {
-		aiFace& face = mesh->mFaces[i];
+		const aiFace& face = mesh->mFaces[i];
 		for (unsigned int j = 0; j < face.mNumIndices; j++) {
 			indices.push_back(face.mIndices[j]);
 		}
 	}
-	// process material
-	if (mesh->mMaterialIndex >= 0) {
-		aiMaterial* material = scene->mMaterials[mesh->mMaterialIndex];
-		
-		vector<Texture> diffuseMaps = loadMaterialTextures(material,
-			aiTextureType_DIFFUSE, "texture_diffuse");
-		textures.insert(textures.end(), diffuseMaps.begin(), diffuseMaps.end());
-		
-		vector<Texture> specularMaps = loadMaterialTextures(material,
-			aiTextureType_SPECULAR, "texture_specular");
-		textures.insert(textures.end(), specularMaps.begin(), specularMaps.end());
-
-		vector<Texture> normalMaps = loadMaterialTextures(material,
-			aiTextureType_HEIGHT, "texture_normal");
-		textures.insert(textures.end(), normalMaps.begin(), normalMaps.end());
-	}
+}
 
-	return Mesh(std::move(vertices), std::move(indices), std::move(textures));
+vector<Texture> Model::loadMeshTextures(aiMesh* mesh, const aiScene* scene) {
+	return LoadMeshTextures(mesh, scene, directory, texturesLoaded);
 }
 
-vector<Texture> Model::loadMaterialTextures(aiMaterial* mat, aiTextureType type, string typeName) {
-	vector<Texture> textures;
+static void loadMaterialTextures(const aiMaterial* mat, aiTextureType type, const char* typeName,
+	const string& directory, vector<Texture>& texturesLoaded, vector<Texture>& textures) {
 	for (unsigned int i = 0; i < mat->GetTextureCount(type); i++) {
 		aiString str;
 		mat->GetTexture(type, i, &str);
@@ -109,6 +322,7 @@ vector<Texture> Model::loadMaterialTextures(aiMaterial* mat, aiTextureType type,
 		}
 		if (skip) continue;
 
+		// only textures seen for the first time allocate their path strings
 		Texture texture;
 		texture.id = TextureFromFile(str.C_Str(), directory);
 		texture.type = typeName;
@@ -116,32 +330,58 @@ vector<Texture> Model::loadMaterialTextures(aiMaterial* mat, aiTextureType type,
 		textures.push_back(texture);
 		texturesLoaded.push_back(texture); // add to loaded textures
 	}
+}
+
+vector<Texture> LoadMeshTextures(const aiMesh* mesh, const aiScene* scene, const string& directory, vector<Texture>& texturesLoaded) {
+	vector<Texture> textures;
+	// process material
+	if (mesh->mMaterialIndex >= 0) {
+		const aiMaterial* material = scene->mMaterials[mesh->mMaterialIndex];
+		textures.reserve(material->GetTextureCount(aiTextureType_DIFFUSE) +
+			material->GetTextureCount(aiTextureType_SPECULAR) + material->GetTextureCount(aiTextureType_HEIGHT));
+
+		loadMaterialTextures(material, aiTextureType_DIFFUSE, "texture_diffuse", directory, texturesLoaded, textures);
+		loadMaterialTextures(material, aiTextureType_SPECULAR, "texture_specular", directory, texturesLoaded, textures);
+		loadMaterialTextures(material, aiTextureType_HEIGHT, "texture_normal", directory, texturesLoaded, textures);
+	}
 	return textures;
 }
 
-unsigned int TextureFromFile(const char* path, const string& directory, bool gammaCorrection, bool clamp) {
+bool LoadTextureImage(const char* path, const string& directory, TextureImage& image) {
 	string filename = string(path);
 	filename = directory + '/' + filename;
 
+	image.data = stbi_load(filename.c_str(), &image.width, &image.height, &image.nrChannels, 0);
+	if (!image.data) {
+		std::cout << "Failed to load texture" << std::endl;
+		return false;
+	}
+	return true;
+}
+
+void FreeTextureImage(TextureImage& image) {
+	stbi_image_free(image.data);
+	image.data = nullptr;
+}
+
+unsigned int TextureFromImage(const TextureImage& image, bool gammaCorrection, bool clamp) {
 	unsigned int id;
 	glGenTextures(1, &id);
 
-	int width, height, nrChannels;
-	unsigned char* data = stbi_load(filename.c_str(), &width, &height, &nrChannels, 0);
-	if (data) {
+	if (image.data) {
 		GLenum dataFormat, internalFormat;
-		if (nrChannels == 1) {
+		if (image.nrChannels == 1) {
 			dataFormat = internalFormat = GL_RED;
-		} else if (nrChannels == 3) {
+		} else if (image.nrChannels == 3) {
 			internalFormat = gammaCorrection ? GL_SRGB : GL_RGB;
 			dataFormat = GL_RGB;
-		} else if (nrChannels == 4) {
+		} else if (image.nrChannels == 4) {
 			internalFormat = gammaCorrection ? GL_SRGB_ALPHA : GL_RGBA;
 			dataFormat = GL_RGBA;
 		}
 
 		glBindTexture(GL_TEXTURE_2D, id);
-		glTexImage2D(GL_TEXTURE_2D, 0, internalFormat, width, height, 0, dataFormat, GL_UNSIGNED_BYTE, data);
+		glTexImage2D(GL_TEXTURE_2D, 0, internalFormat, image.width, image.height, 0, dataFormat, GL_UNSIGNED_BYTE, image.data);
 		glGenerateMipmap(GL_TEXTURE_2D);
 		
 		GLint param = clamp ? GL_CLAMP_TO_EDGE : GL_REPEAT;
@@ -149,10 +389,16 @@ unsigned int TextureFromFile(const char* path, const string& directory, bool gam
 		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, param);
 		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
 		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-	} else {
-		std::cout << "Failed to load texture" << std::endl;
 	}
-	stbi_image_free(data);
+
+	return id;
+}
+
+unsigned int TextureFromFile(const char* path, const string& directory, bool gammaCorrection, bool clamp) {
+	TextureImage image;
+	LoadTextureImage(path, directory, image);
+	unsigned int id = TextureFromImage(image, gammaCorrection, clamp);
+	FreeTextureImage(image);
 
 	return id;
 }
@@ -7,28 +7,117 @@
 
 #include "shader.h"
 #include "mesh.h"
+#include "scene_graph.h"
 
 #include <vector>
 #include <string>
+#include <span>
+
+#include <map>
+#include <memory_resource>
 
 unsigned int TextureFromFile(const char* path, const std::string& directory, bool gammaCorrection = false, bool clamp = false);
 
+// decoded pixels, split from the GL upload so decoding can run off the GL thread
+struct TextureImage {
+	int width = 0, height = 0, nrChannels = 0;
+	unsigned char* data = nullptr;
+};
+bool LoadTextureImage(const char* path, const std::string& directory, TextureImage& image);
+void FreeTextureImage(TextureImage& image);
+unsigned int TextureFromImage(const TextureImage& image, bool gammaCorrection = false, bool clamp = false);
+
+glm::mat4 AssimpToGlm(const aiMatrix4x4& m);
+
+// appends the mesh's vertices and (triangulated) indices
+void ReadMeshGeometry(const aiMesh* mesh, std::pmr::vector<Vertex>& vertices, std::pmr::vector<unsigned int>& indices);
+// moves the vertices by a node transform, normals go through the normal matrix
+void BakeTransform(std::span<Vertex> vertices, const glm::mat4& transform);
+// loads the diffuse, specular and normal maps of the mesh's material, reusing textures already in texturesLoaded
+std::vector<Texture> LoadMeshTextures(const aiMesh* mesh, const aiScene* scene, const std::string& directory, std::vector<Texture>& texturesLoaded);
+
+struct ModelOptions {
+	MeshResidency residency = MeshResidency::Release;
+	// bake node transforms and merge all meshes sharing a material into one mesh.
+	// only for models that are never animated per node.
+	bool staticBatching = false;
+};
+
 class Model {
 public:
-	Model(const char* path) {
+	// where a source mesh ended up after static batching, e.g. for picking
+	struct SubMesh {
+		unsigned int mesh;        // index into meshes
+		unsigned int firstIndex;  // relative to that mesh's indices
+		unsigned int indexCount;
+		unsigned int sourceMesh;  // index into aiScene::mMeshes
+		std::string node;         // node the mesh was attached to
+	};
+
+	Model(const char* path, ModelOptions options = {}) : options(options) {
 		loadModel(path);
 	}
-	void Draw(Shader& shader);
+	// meshes are placed by their node's world transform, then by 'transform'
+	void Draw(Shader& shader, const glm::mat4& transform = glm::mat4(1.0f));
+	// draws one copy per transform; the shader reads the model and normal matrices from the instance attributes
+	void DrawInstanced(Shader& shader, std::span<const glm::mat4> models);
+
+	// the imported node hierarchy, nodes may be moved between draws
+	SceneGraph& Nodes() { return nodes; }
+
+	unsigned int MeshCount() const { return (unsigned int)meshes.size(); }
+	// empty unless the model was loaded with static batching
+	const std::vector<SubMesh>& SubMeshes() const { return subMeshes; }
 private:
+	// meshes sharing a texture set, submitted together with one multi-draw call
+	struct DrawBatch {
+		unsigned int textureMesh; // mesh whose textures are bound for the batch
+		GLsizei drawCount;
+		GLuint firstDraw;         // of the model's draws, and so of its uploaded transforms
+		GLintptr indirectOffset;  // into indirectBuffer (GL 4.3+)
+		std::vector<unsigned int> meshIndices;
+		// glMultiDrawElementsBaseVertex arguments (GL 3.3 fallback)
+		std::vector<GLsizei> counts;
+		std::vector<const void*> offsets;
+		std::vector<GLint> baseVertices;
+	};
+
 	// model data
 	std::vector<Mesh> meshes;
 	std::string directory;
 	std::vector<Texture> texturesLoaded;
+	std::vector<SubMesh> subMeshes;
+	ModelOptions options;
+
+	SceneGraph nodes;
+	std::vector<int> meshNodes; // node of each mesh, -1 for merged meshes whose transforms are baked
+
+	// geometry collected per material index while static batching
+	struct MergedGeometry {
+		std::pmr::vector<Vertex> vertices;
+		std::pmr::vector<unsigned int> indices;
+		std::vector<SubMesh> subMeshes;
+
+		MergedGeometry(std::pmr::memory_resource* resource) : vertices(resource), indices(resource) {}
+	};
+	std::map<unsigned int, MergedGeometry> mergedGeometry;
+	// linear arena backing import temporaries, only set while loading
+	std::pmr::memory_resource* importResource = nullptr;
+
+	// render data
+	std::vector<DrawBatch> batches;
+	unsigned int indirectBuffer = 0;
+	std::vector<glm::mat4> drawTransforms;
 
 	void loadModel(std::string path);
-	void processNode(aiNode* node, const aiScene* scene);
+	void buildDrawBatches();
+	void processNode(aiNode* node, const aiScene* scene, int parentNode, const glm::mat4& parentTransform);
 	Mesh processMesh(aiMesh* mesh, const aiScene* scene);
-	std::vector<Texture> loadMaterialTextures(aiMaterial* mat, aiTextureType type, std::string typeName);
+	void mergeMesh(unsigned int meshIndex, const aiNode* node, const aiScene* scene, const glm::mat4& transform);
+	void buildMergedMeshes(const aiScene* scene);
+	std::size_t measureGeometry(const aiNode* node, const aiScene* scene, std::map<unsigned int, std::pair<std::size_t, std::size_t>>& materialSizes);
+	std::vector<Texture> loadMeshTextures(aiMesh* mesh, const aiScene* scene);
+	glm::mat4 meshTransform(unsigned int mesh, const glm::mat4& transform) const;
 };
 
 #endif
@@ -0,0 +1,210 @@
+#include "occlusion_culler.h"
+#include "simd_math.h"
+#include "simd_kernels.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace {
+	void rasterizeRows(const OccluderTriangle& t, float* depth, int width, int y0, int y1) {
+		for (int y = y0; y < y1; y++) {
+			float py = y + 0.5f;
+			float* row = depth + (std::size_t)y * width;
+			// per-row terms summed first, as the AVX2 path does, so both give the same bits
+			float rowConstants[3];
+			for (int e = 0; e < 3; e++)
+				rowConstants[e] = t.edgeB[e] * py + t.edgeC[e];
+			float zRow = t.zB * py + t.zC;
+
+			for (int x = t.minX; x <= t.maxX; x++) {
+				float px = x + 0.5f;
+				bool inside = true;
+				for (int e = 0; e < 3; e++)
+					inside = inside && t.edgeA[e] * px + rowConstants[e] >= 0.0f;
+				if (inside)
+					row[x] = std::min(row[x], t.zA * px + zRow);
+			}
+		}
+	}
+
+	bool rectVisible(const float* depth, int width, int x0, int x1, int y0, int y1, float nearest) {
+		for (int y = y0; y < y1; y++) {
+			const float* row = depth + (std::size_t)y * width;
+			for (int x = x0; x < x1; x++) {
+				if (row[x] >= nearest)
+					return true;
+			}
+		}
+		return false;
+	}
+}
+
+OcclusionCuller::OcclusionCuller(int width, int height, int bandHeight)
+	: width((width + 7) & ~7), height(height), bandHeight(std::max(bandHeight, 1)), viewProjection(1.0f) {
+	depth.assign((std::size_t)this->width * height, 1.0f);
+}
+
+void OcclusionCuller::Begin(const glm::mat4& viewProjection) {
+	this->viewProjection = viewProjection;
+	triangles.clear();
+}
+
+void OcclusionCuller::AddOccluder(std::span<const glm::vec3> positions, std::span<const unsigned int> indices, const glm::mat4& model) {
+	glm::mat4 mvp = MulMat4(viewProjection, model);
+	for (std::size_t i = 0; i + 2 < indices.size(); i += 3) {
+		glm::vec4 a = mvp * glm::vec4(positions[indices[i]], 1.0f);
+		glm::vec4 b = mvp * glm::vec4(positions[indices[i + 1]], 1.0f);
+		glm::vec4 c = mvp * glm::vec4(positions[indices[i + 2]], 1.0f);
+		addClipTriangle(a, b, c);
+	}
+}
+
+void OcclusionCuller::AddOccluderBox(const AABB& box, const glm::mat4& model) {
+	glm::vec3 corners[8];
+	for (int i = 0; i < 8; i++) {
+		corners[i] = glm::vec3(i & 1 ? box.max.x : box.min.x, i & 2 ? box.max.y : box.min.y, i & 4 ? box.max.z : box.min.z);
+	}
+	static const unsigned int indices[36] = {
+		0, 2, 1, 1, 2, 3, // -z
+		4, 5, 6, 5, 7, 6, // +z
+		0, 4, 2, 2, 4, 6, // -x
+		1, 3, 5, 3, 7, 5, // +x
+		0, 1, 4, 1, 5, 4, // -y
+		2, 6, 3, 3, 6, 7, // +y
+	};
+	AddOccluder(corners, indices, model);
+}
+
+// clips against the near plane (z >= -w) so triangles passing behind the camera still occlude
+void OcclusionCuller::addClipTriangle(const glm::vec4& a, const glm::vec4& b, const glm::vec4& c) {
+	const glm::vec4 in[3] = { a, b, c };
+	float distances[3];
+	int insideCount = 0;
+	for (int i = 0; i < 3; i++) {
+		distances[i] = in[i].z + in[i].w;
+		insideCount += distances[i] >= 0.0f;
+	}
+	if (insideCount == 0)
+		return;
+	if (insideCount == 3) {
+		setupTriangle(a, b, c);
+		return;
+	}
+
+	glm::vec4 out[4];
+	int outCount = 0;
+	for (int i = 0; i < 3; i++) {
+		int j = (i + 1) % 3;
+		if (distances[i] >= 0.0f)
+			out[outCount++] = in[i];
+		if ((distances[i] >= 0.0f) != (distances[j] >= 0.0f)) {
+			float t = distances[i] / (distances[i] - distances[j]);
+			out[outCount++] = in[i] + (in[j] - in[i]) * t;
+		}
+	}
+	for (int i = 1; i + 1 < outCount; i++)
+		setupTriangle(out[0], out[i], out[i + 1]);
+}
+
+void OcclusionCuller::setupTriangle(const glm::vec4& a, const glm::vec4& b, const glm::vec4& c) {
+	const glm::vec4* clip[3] = { &a, &b, &c };
+	float x[3], y[3], z[3];
+	for (int i = 0; i < 3; i++) {
+		float invW = 1.0f / clip[i]->w;
+		x[i] = (clip[i]->x * invW * 0.5f + 0.5f) * width;
+		y[i] = (clip[i]->y * invW * 0.5f + 0.5f) * height;
+		z[i] = clip[i]->z * invW * 0.5f + 0.5f;
+	}
+
+	float area = (x[1] - x[0]) * (y[2] - y[0]) - (x[2] - x[0]) * (y[1] - y[0]);
+	if (std::fabs(area) < 1e-6f)
+		return;
+
+	OccluderTriangle t;
+	t.minX = std::max(0, (int)std::floor(std::min({ x[0], x[1], x[2] })));
+	t.maxX = std::min(width - 1, (int)std::ceil(std::max({ x[0], x[1], x[2] })));
+	t.minY = std::max(0, (int)std::floor(std::min({ y[0], y[1], y[2] })));
+	t.maxY = std::min(height - 1, (int)std::ceil(std::max({ y[0], y[1], y[2] })));
+	if (t.minX > t.maxX || t.minY > t.maxY)
+		return;
+
+	// orient the edges so the inside is positive for either winding
+	float sign = area > 0.0f ? 1.0f : -1.0f;
+	for (int i = 0; i < 3; i++) {
+		int j = (i + 1) % 3;
+		t.edgeA[i] = (y[i] - y[j]) * sign;
+		t.edgeB[i] = (x[j] - x[i]) * sign;
+		t.edgeC[i] = (x[i] * y[j] - x[j] * y[i]) * sign;
+	}
+
+	// depth is linear in screen space after the perspective divide
+	float dzdx = ((z[1] - z[0]) * (y[2] - y[0]) - (z[2] - z[0]) * (y[1] - y[0])) / area;
+	float dzdy = ((z[2] - z[0]) * (x[1] - x[0]) - (z[1] - z[0]) * (x[2] - x[0])) / area;
+	t.zA = dzdx;
+	t.zB = dzdy;
+	t.zC = z[0] - dzdx * x[0] - dzdy * y[0];
+	triangles.push_back(t);
+}
+
+void OcclusionCuller::Render(JobSystem& jobs) {
+	std::fill(depth.begin(), depth.end(), 1.0f);
+#ifdef SIMD_X86
+	bool avx2 = ActiveSimdLevel() == SimdLevel::AVX2;
+#endif
+
+	// bands own disjoint rows, so jobs never write the same pixels
+	unsigned int bandCount = (unsigned int)((height + bandHeight - 1) / bandHeight);
+	jobs.ParallelFor(bandCount, 1, [&](unsigned int begin, unsigned int end) {
+		for (unsigned int band = begin; band < end; band++) {
+			int y0 = (int)band * bandHeight;
+			int y1 = std::min(height, y0 + bandHeight);
+			for (const auto& t : triangles) {
+				int rowBegin = std::max(t.minY, y0);
+				int rowEnd = std::min(t.maxY + 1, y1);
+				if (rowBegin >= rowEnd)
+					continue;
+#ifdef SIMD_X86
+				if (avx2) {
+					avx2::RasterizeOccluderRows(t, depth.data(), width, rowBegin, rowEnd);
+					continue;
+				}
+#endif
+				rasterizeRows(t, depth.data(), width, rowBegin, rowEnd);
+			}
+		}
+	});
+}
+
+bool OcclusionCuller::IsVisible(const AABB& box) const {
+	float minX = (float)width, maxX = 0.0f, minY = (float)height, maxY = 0.0f;
+	float nearest = 1.0f;
+	for (int i = 0; i < 8; i++) {
+		glm::vec4 corner(i & 1 ? box.max.x : box.min.x, i & 2 ? box.max.y : box.min.y, i & 4 ? box.max.z : box.min.z, 1.0f);
+		glm::vec4 clip = viewProjection * corner;
+		// crosses the near plane, the projected rect is meaningless
+		if (clip.z < -clip.w)
+			return true;
+
+		float invW = 1.0f / clip.w;
+		float sx = (clip.x * invW * 0.5f + 0.5f) * width;
+		float sy = (clip.y * invW * 0.5f + 0.5f) * height;
+		minX = std::min(minX, sx);
+		maxX = std::max(maxX, sx);
+		minY = std::min(minY, sy);
+		maxY = std::max(maxY, sy);
+		nearest = std::min(nearest, clip.z * invW * 0.5f + 0.5f);
+	}
+
+	int x0 = std::max(0, (int)std::floor(minX));
+	int x1 = std::min(width, (int)std::ceil(maxX));
+	int y0 = std::max(0, (int)std::floor(minY));
+	int y1 = std::min(height, (int)std::ceil(maxY));
+	if (x0 >= x1 || y0 >= y1)
+		return false;
+
+#ifdef SIMD_X86
+	if (ActiveSimdLevel() == SimdLevel::AVX2)
+		return avx2::DepthRectVisible(depth.data(), width, x0, x1, y0, y1, nearest);
+#endif
+	return rectVisible(depth.data(), width, x0, x1, y0, y1, nearest);
+}
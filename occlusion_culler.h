@@ -0,0 +1,53 @@
+#ifndef OCCLUSION_CULLER_H
+#define OCCLUSION_CULLER_H
+
+#include <glm/glm.hpp>
+
+#include "bounds.h"
+#include "job_system.h"
+
+#include <span>
+#include <vector>
+
+// screen-space triangle ready for rasterisation: inside where all three edge functions
+// E(x, y) = A * x + B * y + C are >= 0, depth = zA * x + zB * y + zC.
+struct OccluderTriangle {
+    float edgeA[3], edgeB[3], edgeC[3];
+    float zA, zB, zC;
+    int minX, maxX, minY, maxY; // pixel bounds, inclusive, clamped to the buffer
+};
+
+// software occlusion culling, independent of the GPU.
+// a few large occluders are rasterised into a small depth buffer split into horizontal
+// bands, one job per band, then occludee boxes are tested against it before drawing.
+class OcclusionCuller {
+public:
+    // width is rounded up to a multiple of 8 so rows can be processed eight pixels at a time
+    OcclusionCuller(int width = 256, int height = 128, int bandHeight = 16);
+
+    // starts a frame: drops the previous occluders
+    void Begin(const glm::mat4& viewProjection);
+    // triangles are clipped against the near plane, both windings are kept
+    void AddOccluder(std::span<const glm::vec3> positions, std::span<const unsigned int> indices, const glm::mat4& model);
+    void AddOccluderBox(const AABB& box, const glm::mat4& model);
+    // rasterises every occluder added since Begin()
+    void Render(JobSystem& jobs = JobSystem::Get());
+
+    // false only when the world-space box is behind the occluders everywhere it covers
+    bool IsVisible(const AABB& box) const;
+
+    int Width() const { return width; }
+    int Height() const { return height; }
+    // depth in [0, 1] per pixel, row 0 at the bottom, 1 where nothing was drawn
+    const std::vector<float>& Depth() const { return depth; }
+private:
+    int width, height, bandHeight;
+    std::vector<float> depth;
+    std::vector<OccluderTriangle> triangles;
+    glm::mat4 viewProjection;
+
+    void addClipTriangle(const glm::vec4& a, const glm::vec4& b, const glm::vec4& c);
+    void setupTriangle(const glm::vec4& a, const glm::vec4& b, const glm::vec4& c);
+};
+
+#endif
@@ -0,0 +1,62 @@
+// compiled with AVX2 enabled (/arch:AVX2, -mavx2), nothing in here may run before the CPU check
+#include "occlusion_culler.h"
+#include "simd_kernels.h"
+
+#ifdef SIMD_X86
+#include <immintrin.h>
+
+namespace avx2 {
+	// eight pixels per step, edge functions and depth stepped incrementally along the row
+	void RasterizeOccluderRows(const OccluderTriangle& t, float* depth, int width, int y0, int y1) {
+		const __m256 laneOffsets = _mm256_setr_ps(0.5f, 1.5f, 2.5f, 3.5f, 4.5f, 5.5f, 6.5f, 7.5f);
+		const __m256 zero = _mm256_setzero_ps();
+		int xBegin = t.minX & ~7;
+
+		for (int y = y0; y < y1; y++) {
+			float py = y + 0.5f;
+			float* row = depth + (std::size_t)y * width;
+			__m256 px = _mm256_add_ps(_mm256_set1_ps((float)xBegin), laneOffsets);
+			__m256 step = _mm256_set1_ps(8.0f);
+
+			__m256 rowConstants[3];
+			for (int e = 0; e < 3; e++)
+				rowConstants[e] = _mm256_set1_ps(t.edgeB[e] * py + t.edgeC[e]);
+			__m256 zRow = _mm256_set1_ps(t.zB * py + t.zC);
+
+			for (int x = xBegin; x <= t.maxX; x += 8) {
+				__m256 inside = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+				for (int e = 0; e < 3; e++) {
+					__m256 value = _mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(t.edgeA[e]), px), rowConstants[e]);
+					inside = _mm256_and_ps(inside, _mm256_cmp_ps(value, zero, _CMP_GE_OQ));
+				}
+				if (!_mm256_testz_ps(inside, inside)) {
+					__m256 z = _mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(t.zA), px), zRow);
+					__m256 current = _mm256_loadu_ps(row + x);
+					_mm256_storeu_ps(row + x, _mm256_blendv_ps(current, _mm256_min_ps(current, z), inside));
+				}
+				px = _mm256_add_ps(px, step);
+			}
+		}
+	}
+
+	bool DepthRectVisible(const float* depth, int width, int x0, int x1, int y0, int y1, float nearest) {
+		const __m256i lanes = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+		__m256 threshold = _mm256_set1_ps(nearest);
+		int xBegin = x0 & ~7;
+
+		for (int y = y0; y < y1; y++) {
+			const float* row = depth + (std::size_t)y * width;
+			for (int x = xBegin; x < x1; x += 8) {
+				// only lanes inside [x0, x1) count
+				__m256i index = _mm256_add_epi32(_mm256_set1_epi32(x), lanes);
+				__m256i inRange = _mm256_and_si256(_mm256_cmpgt_epi32(index, _mm256_set1_epi32(x0 - 1)),
+					_mm256_cmpgt_epi32(_mm256_set1_epi32(x1), index));
+				__m256 behind = _mm256_cmp_ps(_mm256_loadu_ps(row + x), threshold, _CMP_GE_OQ);
+				if (!_mm256_testz_ps(behind, _mm256_castsi256_ps(inRange)))
+					return true;
+			}
+		}
+		return false;
+	}
+}
+#endif
@@ -0,0 +1,205 @@
+#include "post_process.h"
+#include "geometry_heap.h"
+
+#include <fstream>
+#include <sstream>
+
+namespace {
+	const int HDR_UNIT = 0;
+	const int BLOOM_UNIT = 1;
+	const int LUMINANCE_UNIT = 2;
+	const int LUT_UNIT = 3;
+
+	const glm::vec3 luminanceWeights(0.2126f, 0.7152f, 0.0722f);
+
+	std::string readFile(const char* path) {
+		std::ifstream file(path);
+		std::stringstream stream;
+		stream << file.rdbuf();
+		return stream.str();
+	}
+}
+
+namespace Grading {
+	GradingStep Saturation(float saturation) {
+		return [saturation](const glm::vec3& color) {
+			return glm::mix(glm::vec3(glm::dot(color, luminanceWeights)), color, saturation);
+		};
+	}
+
+	GradingStep Contrast(float contrast) {
+		return [contrast](const glm::vec3& color) {
+			return (color - 0.5f) * contrast + 0.5f;
+		};
+	}
+
+	GradingStep LiftGammaGain(const glm::vec3& lift, const glm::vec3& gamma, const glm::vec3& gain) {
+		return [lift, gamma, gain](const glm::vec3& color) {
+			glm::vec3 lifted = gain * (color + lift * (1.0f - color));
+			return glm::pow(glm::max(lifted, glm::vec3(0.0f)), 1.0f / gamma);
+		};
+	}
+}
+
+PostProcess::PostProcess()
+	: bloomStrength(1.0f), exposureKey(0.18f), fixedExposure(1.0f),
+	vertexSource(readFile("./shaders/fullscreen.vs")), rebuilds(0) {
+	glGenVertexArrays(1, &emptyVAO);
+
+	glGenTextures(1, &lut);
+	glBindTexture(GL_TEXTURE_3D, lut);
+	glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+	glBindTexture(GL_TEXTURE_3D, 0);
+	SetGrading({});
+
+	build();
+}
+
+void PostProcess::Configure(const PostProcessConfig& newConfig) {
+	if (newConfig == config)
+		return;
+	config = newConfig;
+	build();
+}
+
+void PostProcess::SetGrading(const std::vector<GradingStep>& steps) {
+	std::vector<glm::vec3> texels;
+	texels.reserve(LUT_SIZE * LUT_SIZE * LUT_SIZE);
+	for (int b = 0; b < LUT_SIZE; b++)
+		for (int g = 0; g < LUT_SIZE; g++)
+			for (int r = 0; r < LUT_SIZE; r++) {
+				glm::vec3 color = glm::vec3(float(r), float(g), float(b)) / float(LUT_SIZE - 1);
+				for (const GradingStep& step : steps)
+					color = glm::clamp(step(color), 0.0f, 1.0f);
+				texels.push_back(color);
+			}
+
+	glBindTexture(GL_TEXTURE_3D, lut);
+	glTexImage3D(GL_TEXTURE_3D, 0, GL_RGB16F, LUT_SIZE, LUT_SIZE, LUT_SIZE, 0, GL_RGB, GL_FLOAT, texels.data());
+	glBindTexture(GL_TEXTURE_3D, 0);
+}
+
+void PostProcess::build() {
+	std::string source = "#version 330 core\n"
+		"// generated by PostProcess, only the enabled steps\n"
+		"layout (location = 0) out vec4 FragColor;\n\n"
+		"uniform sampler2D hdrBuffer;\n"
+		"uniform vec2 texelSize;\n";
+	std::string steps;
+
+	if (config.bloom) {
+		source += "uniform sampler2D bloom;\n"
+			"uniform float bloomStrength;\n";
+		// the bloom chain may be smaller than the image, so it is sampled filtered
+		steps += "    color += texture(bloom, gl_FragCoord.xy * texelSize).rgb * bloomStrength;\n";
+	}
+	if (config.autoExposure) {
+		source += "uniform sampler2D adaptedLuminance;\n"
+			"uniform float exposureKey;\n";
+		steps += "    color *= exposureKey / max(texelFetch(adaptedLuminance, ivec2(0), 0).r, 1e-4);\n";
+	} else {
+		source += "uniform float exposure;\n";
+		steps += "    color *= exposure;\n";
+	}
+
+	switch (config.toneCurve) {
+	case ToneCurve::Exponential:
+		steps += "    color = vec3(1.0) - exp(-color);\n";
+		break;
+	case ToneCurve::Reinhard:
+		steps += "    color = color / (vec3(1.0) + color);\n";
+		break;
+	case ToneCurve::ACES:
+		// Narkowicz's fit of the ACES reference rendering transform
+		steps += "    color = clamp((color * (2.51 * color + 0.03)) / (color * (2.43 * color + 0.59) + 0.14), 0.0, 1.0);\n";
+		break;
+	}
+	steps += "    color = pow(color, vec3(1.0 / 2.2));\n";
+
+	if (config.colorGrading) {
+		// scale and offset put 0 and 1 on the centres of the first and last texels
+		source += "uniform sampler3D lut;\n"
+			"uniform float lutScale;\n"
+			"uniform float lutOffset;\n";
+		steps += "    color = texture(lut, clamp(color, 0.0, 1.0) * lutScale + lutOffset).rgb;\n";
+	}
+	if (config.dither) {
+		// interleaved gradient noise, one 8-bit step wide
+		steps += "    float noise = fract(52.9829189 * fract(dot(gl_FragCoord.xy, vec2(0.06711056, 0.00583715))));\n"
+			"    color += (noise - 0.5) / 255.0;\n";
+	}
+
+	source += "\nvoid main() {\n"
+		"    vec3 color = texelFetch(hdrBuffer, ivec2(gl_FragCoord.xy), 0).rgb;\n"
+		+ steps +
+		"    FragColor = vec4(color, 1.0);\n"
+		"}\n";
+	fragmentSource = source;
+
+	if (program)
+		glDeleteProgram(program->ID);
+	program = std::make_unique<Shader>(Shader::FromSource(vertexSource, fragmentSource));
+	program->use();
+	program->setInt("hdrBuffer", HDR_UNIT);
+	program->setInt("bloom", BLOOM_UNIT);
+	program->setInt("adaptedLuminance", LUMINANCE_UNIT);
+	program->setInt("lut", LUT_UNIT);
+	program->setFloat("lutScale", (LUT_SIZE - 1.0f) / LUT_SIZE);
+	program->setFloat("lutOffset", 0.5f / LUT_SIZE);
+	rebuilds++;
+}
+
+void PostProcess::AddPass(RenderGraph& graph, RenderResource hdrColor, RenderResource bloom, RenderResource luminance) {
+	bool useBloom = config.bloom;
+	bool useLuminance = config.autoExposure;
+
+	graph.AddPass("post process", [&](RenderGraph::Builder& builder) {
+		builder.Read(hdrColor);
+		if (useBloom)
+			builder.Read(bloom);
+		if (useLuminance)
+			builder.Read(luminance);
+		builder.WriteBackbuffer();
+	}, [this, hdrColor, bloom, luminance, useBloom, useLuminance](RenderGraph& g) {
+		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+		GLboolean depthTest = glIsEnabled(GL_DEPTH_TEST);
+		GLboolean blend = glIsEnabled(GL_BLEND);
+		glDisable(GL_DEPTH_TEST);
+		glDisable(GL_BLEND);
+
+		program->use();
+		program->setVec2("texelSize", 1.0f / g.Width(), 1.0f / g.Height());
+		program->setFloat("bloomStrength", bloomStrength);
+		program->setFloat("exposureKey", exposureKey);
+		program->setFloat("exposure", fixedExposure);
+
+		glActiveTexture(GL_TEXTURE0 + HDR_UNIT);
+		glBindTexture(GL_TEXTURE_2D, g.Texture(hdrColor));
+		if (useBloom) {
+			glActiveTexture(GL_TEXTURE0 + BLOOM_UNIT);
+			glBindTexture(GL_TEXTURE_2D, g.Texture(bloom));
+		}
+		if (useLuminance) {
+			glActiveTexture(GL_TEXTURE0 + LUMINANCE_UNIT);
+			glBindTexture(GL_TEXTURE_2D, g.Texture(luminance));
+		}
+		if (config.colorGrading) {
+			glActiveTexture(GL_TEXTURE0 + LUT_UNIT);
+			glBindTexture(GL_TEXTURE_3D, lut);
+		}
+		glActiveTexture(GL_TEXTURE0);
+
+		GeometryHeap::BindExternal(emptyVAO);
+		glDrawArrays(GL_TRIANGLES, 0, 3);
+
+		if (depthTest)
+			glEnable(GL_DEPTH_TEST);
+		if (blend)
+			glEnable(GL_BLEND);
+	});
+}
@@ -0,0 +1,81 @@
+#ifndef POST_PROCESS_H
+#define POST_PROCESS_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include "shader.h"
+#include "render_graph.h"
+
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+enum class ToneCurve { Exponential, Reinhard, ACES };
+
+// which per-pixel steps the post-process pass runs. they always run in this order:
+// bloom combine, exposure, tone curve, gamma, colour grading, dither
+struct PostProcessConfig {
+    bool bloom = true;
+    bool autoExposure = true; // exposure from the adapted luminance, otherwise the fixed exposure
+    ToneCurve toneCurve = ToneCurve::Exponential;
+    bool colorGrading = false; // through the baked LUT
+    bool dither = true; // breaks up banding in the 8-bit backbuffer
+
+    bool operator==(const PostProcessConfig& other) const = default;
+};
+
+// colour grading step, maps a gamma-encoded colour in [0, 1] to another
+using GradingStep = std::function<glm::vec3(const glm::vec3&)>;
+
+namespace Grading {
+    GradingStep Saturation(float saturation);
+    // around the middle of the range
+    GradingStep Contrast(float contrast);
+    GradingStep LiftGammaGain(const glm::vec3& lift, const glm::vec3& gamma, const glm::vec3& gain);
+}
+
+// everything between the lit HDR image and the backbuffer in one fullscreen pass.
+// the enabled steps are stitched into one generated fragment shader, rebuilt only when the
+// configuration changes, and any number of grading steps are baked into one 32^3 LUT, so the
+// frame pays a single read and write of the image however much is stacked on it.
+class PostProcess {
+public:
+    static const int LUT_SIZE = 32;
+
+    PostProcess();
+
+    // regenerates the program if the configuration differs from the current one
+    void Configure(const PostProcessConfig& config);
+    const PostProcessConfig& Config() const { return config; }
+    // bakes the steps, applied in order, into the LUT. no steps is the identity
+    void SetGrading(const std::vector<GradingStep>& steps);
+
+    void SetBloomStrength(float strength) { bloomStrength = strength; }
+    // the adapted luminance is mapped to the key, the fixed exposure multiplies the colour as is
+    void SetExposure(float key, float fixed) { exposureKey = key; fixedExposure = fixed; }
+
+    // adds the pass writing the backbuffer. inputs the configuration leaves out are not read, so the
+    // graph culls whatever produced them, and may be NO_RESOURCE
+    void AddPass(RenderGraph& graph, RenderResource hdrColor, RenderResource bloom, RenderResource luminance);
+
+    // how often the program was generated
+    unsigned int Rebuilds() const { return rebuilds; }
+    // the generated fragment shader, for debugging
+    const std::string& Source() const { return fragmentSource; }
+private:
+    PostProcessConfig config;
+    float bloomStrength;
+    float exposureKey, fixedExposure;
+
+    std::string vertexSource, fragmentSource;
+    std::unique_ptr<Shader> program;
+    unsigned int rebuilds;
+    unsigned int lut;
+    unsigned int emptyVAO;
+
+    void build();
+};
+
+#endif
@@ -0,0 +1,375 @@
+#include "render_graph.h"
+#include "format_precision.h"
+
+#include <algorithm>
+#include <iostream>
+#include <unordered_map>
+
+namespace {
+	bool isDepthFormat(GLenum format) {
+		return format == GL_DEPTH_COMPONENT16 || format == GL_DEPTH_COMPONENT24 || format == GL_DEPTH_COMPONENT32F
+			|| format == GL_DEPTH24_STENCIL8 || format == GL_DEPTH32F_STENCIL8;
+	}
+
+	bool hasStencil(GLenum format) {
+		return format == GL_DEPTH24_STENCIL8 || format == GL_DEPTH32F_STENCIL8;
+	}
+
+	// client format and type to specify storage with, no data is uploaded
+	void externalFormat(GLenum internalFormat, GLenum& format, GLenum& type) {
+		type = GL_FLOAT;
+		switch (internalFormat) {
+		case GL_DEPTH24_STENCIL8:
+			format = GL_DEPTH_STENCIL;
+			type = GL_UNSIGNED_INT_24_8;
+			break;
+		case GL_DEPTH32F_STENCIL8:
+			format = GL_DEPTH_STENCIL;
+			type = GL_FLOAT_32_UNSIGNED_INT_24_8_REV;
+			break;
+		case GL_R8: case GL_R16F: case GL_R32F:
+			format = GL_RED;
+			break;
+		case GL_RG8: case GL_RG16F: case GL_RG32F:
+			format = GL_RG;
+			break;
+		case GL_R11F_G11F_B10F: case GL_RGB8: case GL_RGB16F: case GL_RGB32F:
+			format = GL_RGB;
+			break;
+		default:
+			format = isDepthFormat(internalFormat) ? GL_DEPTH_COMPONENT : GL_RGBA;
+			break;
+		}
+	}
+
+	std::size_t bytesPerPixel(GLenum internalFormat) {
+		switch (internalFormat) {
+		case GL_R8:
+			return 1;
+		case GL_RG8: case GL_R16F: case GL_DEPTH_COMPONENT16:
+			return 2;
+		case GL_RGBA16F: case GL_RG32F: case GL_DEPTH32F_STENCIL8:
+			return 8;
+		case GL_RGB16F:
+			return 6;
+		case GL_RGB32F:
+			return 12;
+		case GL_RGBA32F:
+			return 16;
+		default:
+			return 4;
+		}
+	}
+
+	int channels(GLenum format) {
+		switch (format) {
+		case GL_RED: return 1;
+		case GL_RG: return 2;
+		case GL_RGB: return 3;
+		default: return 4;
+		}
+	}
+
+	// attaches a 4x4 texture of the format, then clears it to HDR values and reads them back
+	bool probeFormat(GLenum internalFormat) {
+		GLint previousFramebuffer, previousTexture;
+		glGetIntegerv(GL_FRAMEBUFFER_BINDING, &previousFramebuffer);
+		glGetIntegerv(GL_TEXTURE_BINDING_2D, &previousTexture);
+
+		GLenum format, type;
+		externalFormat(internalFormat, format, type);
+		unsigned int texture, fbo;
+		glGenTextures(1, &texture);
+		glBindTexture(GL_TEXTURE_2D, texture);
+		glTexImage2D(GL_TEXTURE_2D, 0, internalFormat, 4, 4, 0, format, type, NULL);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+		glGenFramebuffers(1, &fbo);
+		glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+		GLenum attachment = !isDepthFormat(internalFormat) ? GL_COLOR_ATTACHMENT0
+			: hasStencil(internalFormat) ? GL_DEPTH_STENCIL_ATTACHMENT : GL_DEPTH_ATTACHMENT;
+		glFramebufferTexture2D(GL_FRAMEBUFFER, attachment, GL_TEXTURE_2D, texture, 0);
+		if (isDepthFormat(internalFormat)) {
+			glDrawBuffer(GL_NONE);
+			glReadBuffer(GL_NONE);
+		}
+		bool supported = glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE;
+
+		if (supported && RelativePrecision(internalFormat) > 0.0f) {
+			float pixel[4] = {};
+			glClearBufferfv(GL_COLOR, 0, FORMAT_PROBE_VALUES);
+			glReadPixels(0, 0, 1, 1, GL_RGBA, GL_FLOAT, pixel);
+			supported = ProbeReadbackMatches(internalFormat, pixel, channels(format));
+		}
+
+		glBindFramebuffer(GL_FRAMEBUFFER, previousFramebuffer);
+		glBindTexture(GL_TEXTURE_2D, previousTexture);
+		glDeleteFramebuffers(1, &fbo);
+		glDeleteTextures(1, &texture);
+		return supported;
+	}
+
+	std::size_t textureBytes(const RenderTextureDesc& desc) {
+		std::size_t bytes = 0;
+		for (int level = 0; level < desc.levels; level++)
+			bytes += (std::size_t)std::max(1, desc.width >> level) * std::max(1, desc.height >> level);
+		return bytes * bytesPerPixel(desc.internalFormat);
+	}
+}
+
+RenderGraph::RenderGraph() : width(0), height(0), frame(0) {
+}
+
+RenderGraph::~RenderGraph() {
+	for (const Framebuffer& framebuffer : framebuffers)
+		glDeleteFramebuffers(1, &framebuffer.fbo);
+	for (const PooledTexture& texture : pool)
+		glDeleteTextures(1, &texture.texture);
+}
+
+RenderResource RenderGraph::Builder::Create(const std::string& name, const RenderTextureDesc& desc) {
+	graph.resources.push_back({ name, desc, 0, false, -1, -1 });
+	return (RenderResource)graph.resources.size() - 1;
+}
+
+RenderResource RenderGraph::Builder::Read(RenderResource resource) {
+	graph.passes[pass].reads.push_back(resource);
+	return resource;
+}
+
+RenderResource RenderGraph::Builder::Write(RenderResource resource) {
+	graph.passes[pass].writes.push_back(resource);
+	return resource;
+}
+
+void RenderGraph::Builder::WriteBackbuffer() {
+	graph.passes[pass].backbuffer = true;
+}
+
+void RenderGraph::Reset(int width, int height) {
+	this->width = width;
+	this->height = height;
+	resources.clear();
+	passes.clear();
+	frame++;
+}
+
+RenderResource RenderGraph::Import(const std::string& name, unsigned int texture, const RenderTextureDesc& desc) {
+	resources.push_back({ name, desc, texture, true, -1, -1 });
+	return (RenderResource)resources.size() - 1;
+}
+
+void RenderGraph::AddPass(const std::string& name, const std::function<void(Builder&)>& setup, std::function<void(RenderGraph&)> execute) {
+	passes.push_back({ name, std::move(execute), {}, {}, false, false });
+	Builder builder(*this, (int)passes.size() - 1);
+	setup(builder);
+}
+
+bool RenderGraph::Supports(GLenum internalFormat) {
+	static std::unordered_map<GLenum, bool> probed;
+	auto it = probed.find(internalFormat);
+	if (it == probed.end())
+		it = probed.emplace(internalFormat, probeFormat(internalFormat)).first;
+	return it->second;
+}
+
+GLenum RenderGraph::NegotiateFormat(std::initializer_list<GLenum> preferred) {
+	for (GLenum format : preferred) {
+		if (Supports(format))
+			return format;
+		std::cout << "Render target format 0x" << std::hex << format << std::dec << " not usable, trying the next one" << std::endl;
+	}
+	return *(preferred.end() - 1);
+}
+
+// a free pooled texture of this exact description, a new one if there is none
+std::size_t RenderGraph::acquire(const RenderTextureDesc& desc) {
+	for (std::size_t i = 0; i < pool.size(); i++) {
+		if (!pool[i].taken && pool[i].desc == desc)
+			return i;
+	}
+
+	GLenum format, type;
+	externalFormat(desc.internalFormat, format, type);
+	unsigned int texture;
+	glGenTextures(1, &texture);
+	glBindTexture(GL_TEXTURE_2D, texture);
+	for (int level = 0; level < desc.levels; level++) {
+		glTexImage2D(GL_TEXTURE_2D, level, desc.internalFormat, std::max(1, desc.width >> level), std::max(1, desc.height >> level),
+			0, format, type, NULL);
+	}
+	GLint filter = isDepthFormat(desc.internalFormat) ? GL_NEAREST : GL_LINEAR;
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, desc.levels > 1 ? GL_LINEAR_MIPMAP_NEAREST : filter);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, filter);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, desc.levels - 1);
+	glBindTexture(GL_TEXTURE_2D, 0);
+
+	pool.push_back({ desc, texture, frame, false });
+	return pool.size() - 1;
+}
+
+void RenderGraph::Compile() {
+	stats = RenderGraphStats();
+	stats.passes = (unsigned int)passes.size();
+
+	// walking backwards, a pass is live if it draws to the screen or writes something a live pass reads
+	std::vector<bool> needed(resources.size(), false);
+	for (std::size_t p = passes.size(); p > 0; p--) {
+		Pass& pass = passes[p - 1];
+		pass.live = pass.backbuffer;
+		for (RenderResource resource : pass.writes)
+			pass.live = pass.live || needed[resource];
+		if (!pass.live) {
+			stats.culledPasses++;
+			continue;
+		}
+		for (RenderResource resource : pass.reads)
+			needed[resource] = true;
+	}
+
+	// lifetimes over the live passes
+	for (int p = 0; p < (int)passes.size(); p++) {
+		if (!passes[p].live)
+			continue;
+		for (const auto* list : { &passes[p].reads, &passes[p].writes }) {
+			for (RenderResource resource : *list) {
+				Resource& r = resources[resource];
+				if (r.firstPass < 0)
+					r.firstPass = p;
+				r.lastPass = p;
+			}
+		}
+	}
+
+	// hand out pooled textures in pass order, returning them after their last pass
+	for (PooledTexture& texture : pool)
+		texture.taken = false;
+	std::vector<std::size_t> holder(resources.size());
+	std::vector<bool> counted(pool.size(), false);
+	for (int p = 0; p < (int)passes.size(); p++) {
+		if (!passes[p].live)
+			continue;
+		for (std::size_t r = 0; r < resources.size(); r++) {
+			Resource& resource = resources[r];
+			if (resource.imported || resource.firstPass != p)
+				continue;
+			std::size_t index = acquire(resource.desc);
+			pool[index].taken = true;
+			pool[index].lastFrame = frame;
+			resource.texture = pool[index].texture;
+			holder[r] = index;
+
+			stats.transientTextures++;
+			stats.transientBytes += textureBytes(resource.desc);
+			counted.resize(pool.size(), false);
+			if (!counted[index]) {
+				counted[index] = true;
+				stats.physicalTextures++;
+				stats.allocatedBytes += textureBytes(resource.desc);
+			}
+		}
+		for (std::size_t r = 0; r < resources.size(); r++) {
+			if (!resources[r].imported && resources[r].lastPass == p)
+				pool[holder[r]].taken = false;
+		}
+	}
+}
+
+void RenderGraph::Execute() {
+	for (Pass& pass : passes) {
+		if (!pass.live)
+			continue;
+		if (pass.backbuffer) {
+			glBindFramebuffer(GL_FRAMEBUFFER, 0);
+			glViewport(0, 0, width, height);
+		} else if (!pass.writes.empty()) {
+			std::vector<RenderResource> colors;
+			RenderResource depth = NO_RESOURCE;
+			for (RenderResource resource : pass.writes) {
+				if (isDepthFormat(resources[resource].desc.internalFormat))
+					depth = resource;
+				else
+					colors.push_back(resource);
+			}
+			bindTargets(colors, depth, 0);
+		}
+		pass.execute(*this);
+	}
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	collectGarbage();
+}
+
+void RenderGraph::BindTargets(std::initializer_list<RenderResource> colors, RenderResource depth, int level) {
+	bindTargets(std::vector<RenderResource>(colors), depth, level);
+}
+
+void RenderGraph::bindTargets(const std::vector<RenderResource>& colors, RenderResource depth, int level) {
+	std::vector<unsigned int> textures;
+	for (RenderResource resource : colors)
+		textures.push_back(resources[resource].texture);
+	unsigned int depthTexture = depth != NO_RESOURCE ? resources[depth].texture : 0;
+
+	auto it = std::find_if(framebuffers.begin(), framebuffers.end(), [&](const Framebuffer& framebuffer) {
+		return framebuffer.colors == textures && framebuffer.depth == depthTexture && framebuffer.level == level;
+	});
+	if (it == framebuffers.end()) {
+		Framebuffer framebuffer = { textures, depthTexture, level, 0, frame };
+		glGenFramebuffers(1, &framebuffer.fbo);
+		glBindFramebuffer(GL_FRAMEBUFFER, framebuffer.fbo);
+		std::vector<GLenum> attachments;
+		for (std::size_t i = 0; i < textures.size(); i++) {
+			glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0 + (GLenum)i, GL_TEXTURE_2D, textures[i], level);
+			attachments.push_back(GL_COLOR_ATTACHMENT0 + (GLenum)i);
+		}
+		if (depthTexture) {
+			GLenum attachment = hasStencil(resources[depth].desc.internalFormat) ? GL_DEPTH_STENCIL_ATTACHMENT : GL_DEPTH_ATTACHMENT;
+			glFramebufferTexture2D(GL_FRAMEBUFFER, attachment, GL_TEXTURE_2D, depthTexture, level);
+		}
+		if (attachments.empty())
+			glDrawBuffer(GL_NONE);
+		else
+			glDrawBuffers((GLsizei)attachments.size(), attachments.data());
+		if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+			std::cout << "Render graph framebuffer not complete!" << std::endl;
+		framebuffers.push_back(framebuffer);
+		it = framebuffers.end() - 1;
+	} else {
+		glBindFramebuffer(GL_FRAMEBUFFER, it->fbo);
+	}
+	it->lastFrame = frame;
+
+	const RenderTextureDesc& desc = resources[colors.empty() ? depth : colors[0]].desc;
+	glViewport(0, 0, std::max(1, desc.width >> level), std::max(1, desc.height >> level));
+}
+
+// framebuffers go first since they may reference a texture that is about to be deleted
+void RenderGraph::collectGarbage() {
+	auto stale = [&](unsigned int lastFrame) { return frame - lastFrame > KEEP_FRAMES; };
+
+	std::vector<unsigned int> deleted;
+	for (const PooledTexture& texture : pool) {
+		if (stale(texture.lastFrame))
+			deleted.push_back(texture.texture);
+	}
+	auto references = [&](const Framebuffer& framebuffer) {
+		for (unsigned int texture : deleted) {
+			if (framebuffer.depth == texture || std::find(framebuffer.colors.begin(), framebuffer.colors.end(), texture) != framebuffer.colors.end())
+				return true;
+		}
+		return false;
+	};
+	std::erase_if(framebuffers, [&](const Framebuffer& framebuffer) {
+		if (!stale(framebuffer.lastFrame) && !references(framebuffer))
+			return false;
+		glDeleteFramebuffers(1, &framebuffer.fbo);
+		return true;
+	});
+	std::erase_if(pool, [&](const PooledTexture& texture) {
+		if (!stale(texture.lastFrame))
+			return false;
+		glDeleteTextures(1, &texture.texture);
+		return true;
+	});
+}
@@ -0,0 +1,132 @@
+#ifndef RENDER_GRAPH_H
+#define RENDER_GRAPH_H
+
+#include <glad/glad.h>
+
+#include <cstddef>
+#include <functional>
+#include <initializer_list>
+#include <string>
+#include <vector>
+
+// a texture of the graph, only valid for the frame it was declared in
+using RenderResource = int;
+const RenderResource NO_RESOURCE = -1;
+
+struct RenderTextureDesc {
+    GLenum internalFormat = GL_RGBA16F;
+    int width = 0, height = 0;
+    int levels = 1;
+
+    bool operator==(const RenderTextureDesc& other) const = default;
+};
+
+// statistics of the last Compile()
+struct RenderGraphStats {
+    unsigned int passes = 0;
+    unsigned int culledPasses = 0;
+    unsigned int transientTextures = 0; // declared by the passes
+    unsigned int physicalTextures = 0; // backing them after aliasing
+    std::size_t transientBytes = 0; // if every transient had its own texture
+    std::size_t allocatedBytes = 0;
+};
+
+// render passes of one frame and the textures they exchange.
+// passes declare what they create, read and write in a setup callback that runs right away.
+// Compile() culls the passes nothing visible depends on and backs the transient textures with
+// pooled GL textures, handing one texture to several resources whose lifetimes don't overlap.
+// Execute() runs the passes in declaration order with their written textures bound as the
+// framebuffer. the pool outlives the frame, textures it did not hand out for a few frames
+// (the old size after a resize, say) are deleted.
+class RenderGraph {
+public:
+    class Builder {
+    public:
+        // allocated before the first pass using it, free for reuse after the last
+        RenderResource Create(const std::string& name, const RenderTextureDesc& desc);
+        RenderResource Read(RenderResource resource);
+        // written textures are bound before the pass runs: colours in declaration order, a depth format as depth
+        RenderResource Write(RenderResource resource);
+        // the pass draws to the default framebuffer and is never culled
+        void WriteBackbuffer();
+    private:
+        friend class RenderGraph;
+        Builder(RenderGraph& graph, int pass) : graph(graph), pass(pass) {}
+        RenderGraph& graph;
+        int pass;
+    };
+
+    RenderGraph();
+    ~RenderGraph();
+
+    // drops last frame's passes and resources, width and height are the backbuffer's
+    void Reset(int width, int height);
+    int Width() const { return width; }
+    int Height() const { return height; }
+
+    // texture owned outside the graph, never aliased
+    RenderResource Import(const std::string& name, unsigned int texture, const RenderTextureDesc& desc);
+    void AddPass(const std::string& name, const std::function<void(Builder&)>& setup, std::function<void(RenderGraph&)> execute);
+
+    void Compile();
+    void Execute();
+
+    // valid once compiled
+    unsigned int Texture(RenderResource resource) const { return resources[resource].texture; }
+    const RenderTextureDesc& Desc(RenderResource resource) const { return resources[resource].desc; }
+    // binds a cached framebuffer with these attachments at the given mip level, the viewport follows the level's size
+    void BindTargets(std::initializer_list<RenderResource> colors, RenderResource depth = NO_RESOURCE, int level = 0);
+
+    const RenderGraphStats& Stats() const { return stats; }
+
+    // whether the format can be rendered to on this context and, for float formats, holds HDR
+    // values to its nominal precision. probed once per format with a tiny framebuffer
+    static bool Supports(GLenum internalFormat);
+    // the first supported format of the list, the last one if none is
+    static GLenum NegotiateFormat(std::initializer_list<GLenum> preferred);
+private:
+    // textures and framebuffers unused for this many frames are deleted
+    static const unsigned int KEEP_FRAMES = 3;
+
+    struct Resource {
+        std::string name;
+        RenderTextureDesc desc;
+        unsigned int texture;
+        bool imported;
+        int firstPass, lastPass;
+    };
+    struct Pass {
+        std::string name;
+        std::function<void(RenderGraph&)> execute;
+        std::vector<RenderResource> reads, writes;
+        bool backbuffer;
+        bool live;
+    };
+    struct PooledTexture {
+        RenderTextureDesc desc;
+        unsigned int texture;
+        unsigned int lastFrame;
+        bool taken;
+    };
+    struct Framebuffer {
+        std::vector<unsigned int> colors;
+        unsigned int depth;
+        int level;
+        unsigned int fbo;
+        unsigned int lastFrame;
+    };
+
+    int width, height;
+    unsigned int frame;
+    std::vector<Resource> resources;
+    std::vector<Pass> passes;
+    std::vector<PooledTexture> pool;
+    std::vector<Framebuffer> framebuffers;
+    RenderGraphStats stats;
+
+    std::size_t acquire(const RenderTextureDesc& desc);
+    void bindTargets(const std::vector<RenderResource>& colors, RenderResource depth, int level);
+    void collectGarbage();
+};
+
+#endif
@@ -0,0 +1,343 @@
+#include "render_queue.h"
+
+#include "mesh.h"
+
+#include <algorithm>
+#include <chrono>
+
+namespace {
+	// opaque keys give depth fewer bits, below the range, so equal geometry sorts together
+	const int OPAQUE_DEPTH_BITS = 16;
+	const int TRANSPARENT_DEPTH_BITS = 24;
+	const int RANGE_BITS = 12;
+	// Auto materials re-time the mode they are not using every this many measurements
+	const unsigned int PREPASS_RETRY = 64;
+	const double PREPASS_SMOOTHING = 0.1;
+}
+
+RenderQueue::RenderQueue() : eye(0.0f), farPlane(100.0f) {
+}
+
+unsigned int RenderQueue::RegisterMaterial(RenderMaterial material) {
+	MaterialTiming timing;
+	if (material.prepass == PrepassMode::Auto)
+		glGenQueries(2, timing.queries);
+	materials.push_back(std::move(material));
+	timings.push_back(timing);
+	return (unsigned int)materials.size() - 1;
+}
+
+bool RenderQueue::UsesPrepass(unsigned int material) const {
+	if (!depthProgram)
+		return false;
+	switch (materials[material].prepass) {
+	case PrepassMode::On:
+		return true;
+	case PrepassMode::Auto:
+		return timings[material].prepass;
+	default:
+		return false;
+	}
+}
+
+// folds finished measurements into the per-mode cost and picks the mode of the next one.
+// a mode that was never timed is tried first, after that the other one is retried now and then
+// since the cost of both depends on how much of the material is on screen.
+void RenderQueue::collectTimings() {
+	for (std::size_t m = 0; m < materials.size(); m++) {
+		MaterialTiming& timing = timings[m];
+		timing.measuring = false;
+		if (materials[m].prepass != PrepassMode::Auto || !depthProgram)
+			continue;
+
+		if (timing.pending) {
+			// the main pass query ends last, once it is done the pre-pass one is too
+			GLuint last = timing.queries[timing.issued[1] ? 1 : 0];
+			GLuint available = 0;
+			glGetQueryObjectuiv(last, GL_QUERY_RESULT_AVAILABLE, &available);
+			if (!available)
+				continue;
+
+			GLuint64 nanoseconds = 0;
+			for (int q = 0; q < 2; q++) {
+				if (!timing.issued[q])
+					continue;
+				GLuint64 elapsed = 0;
+				glGetQueryObjectui64v(timing.queries[q], GL_QUERY_RESULT, &elapsed);
+				nanoseconds += elapsed;
+			}
+			double& cost = timing.milliseconds[timing.prepass];
+			double sample = nanoseconds / 1e6;
+			cost = cost < 0.0 ? sample : cost + (sample - cost) * PREPASS_SMOOTHING;
+			timing.pending = false;
+
+			bool other = !timing.prepass;
+			if (timing.milliseconds[other] < 0.0 || ++timing.samples % PREPASS_RETRY == 0)
+				timing.prepass = other;
+			else
+				timing.prepass = timing.milliseconds[1] < timing.milliseconds[0];
+		}
+		timing.measuring = true;
+		timing.issued[0] = timing.issued[1] = false;
+	}
+}
+
+// timer queries can't nest, so a material's interval ends where the next material's begins.
+// a material drawn again later in the same pass (under another program) is not timed twice.
+void RenderQueue::switchTiming(int& timed, unsigned int material, int pass) {
+	if (timed == (int)material)
+		return;
+	endTiming(timed);
+	MaterialTiming& timing = timings[material];
+	if (!timing.measuring || timing.issued[pass])
+		return;
+	glBeginQuery(GL_TIME_ELAPSED, timing.queries[pass]);
+	timing.issued[pass] = true;
+	timed = (int)material;
+}
+
+void RenderQueue::endTiming(int& timed) {
+	if (timed < 0)
+		return;
+	glEndQuery(GL_TIME_ELAPSED);
+	timed = -1;
+}
+
+unsigned int RenderQueue::programIndex(Shader* shader) {
+	auto it = std::find(programs.begin(), programs.end(), shader);
+	if (it != programs.end())
+		return (unsigned int)(it - programs.begin());
+	programs.push_back(shader);
+	return (unsigned int)programs.size() - 1;
+}
+
+unsigned int RenderQueue::heapIndex(GeometryHeap* heap) {
+	auto it = std::find(heaps.begin(), heaps.end(), heap);
+	if (it != heaps.end())
+		return (unsigned int)(it - heaps.begin());
+	heaps.push_back(heap);
+	return (unsigned int)heaps.size() - 1;
+}
+
+// ids only have to tell the ranges of one batch apart, past 4096 of them equal ids merely sort together
+unsigned int RenderQueue::rangeIndex(const GeometryRange& range) {
+	uint64_t id = ((uint64_t)range.firstIndex << 32) | (uint32_t)range.baseVertex;
+	return ranges.try_emplace(id, (unsigned int)ranges.size()).first->second;
+}
+
+void RenderQueue::BeginFrame() {
+	collectTimings();
+}
+
+void RenderQueue::Begin(const glm::vec3& eye, float farPlane) {
+	this->eye = eye;
+	this->farPlane = farPlane;
+	keys.clear();
+	items.clear();
+	ranges.clear();
+}
+
+void RenderQueue::Submit(RenderPass pass, Shader& shader, unsigned int material, GeometryHeap& heap,
+	const GeometryRange& range, const glm::mat4& model, GLenum mode, GLuint condition) {
+	float distance = glm::length(glm::vec3(model[3]) - eye);
+	float normalized = std::clamp(distance / farPlane, 0.0f, 1.0f);
+
+	uint64_t program = programIndex(&shader) & 0xFF;
+	uint64_t materialId = material & 0xFFFF;
+	uint64_t heapId = heapIndex(&heap) & 0xFF;
+	uint64_t state = (program << 24) | (materialId << 8) | heapId;
+
+	uint64_t key = (uint64_t)pass << 60;
+	if (pass == RenderPass::Opaque) {
+		const uint64_t depthMax = (1ull << OPAQUE_DEPTH_BITS) - 1;
+		uint64_t rangeId = rangeIndex(range) & ((1u << RANGE_BITS) - 1);
+		key |= (state << (RANGE_BITS + OPAQUE_DEPTH_BITS)) | (rangeId << OPAQUE_DEPTH_BITS) | (uint64_t)(normalized * depthMax);
+	} else {
+		const uint64_t depthMax = (1ull << TRANSPARENT_DEPTH_BITS) - 1;
+		key |= ((depthMax - (uint64_t)(normalized * depthMax)) << 32) | state;
+	}
+
+	keys.push_back(key);
+	items.push_back({ &shader, material, &heap, range, mode, condition, model });
+}
+
+// LSD radix sort of the keys, 8 bits per pass. bytes every key agrees on are skipped.
+void RenderQueue::radixSort() {
+	std::size_t count = keys.size();
+	order.resize(count);
+	for (std::size_t i = 0; i < count; i++)
+		order[i] = (uint32_t)i;
+	keyScratch.resize(count);
+	orderScratch.resize(count);
+
+	for (int shift = 0; shift < 64; shift += 8) {
+		std::size_t histogram[256] = {};
+		for (std::size_t i = 0; i < count; i++)
+			histogram[(keys[i] >> shift) & 0xFF]++;
+		if (histogram[(keys[0] >> shift) & 0xFF] == count)
+			continue;
+
+		std::size_t offset = 0;
+		for (int b = 0; b < 256; b++) {
+			std::size_t n = histogram[b];
+			histogram[b] = offset;
+			offset += n;
+		}
+		for (std::size_t i = 0; i < count; i++) {
+			std::size_t dst = histogram[(keys[i] >> shift) & 0xFF]++;
+			keyScratch[dst] = keys[i];
+			orderScratch[dst] = order[i];
+		}
+		keys.swap(keyScratch);
+		order.swap(orderScratch);
+	}
+}
+
+// the run starting at begin: extends while the state and the range stay the same
+std::size_t RenderQueue::runEnd(std::size_t begin) const {
+	const DrawItem& item = items[order[begin]];
+	uint64_t pass = keys[begin] >> 60;
+	std::size_t end = begin + 1;
+	while (end < items.size()) {
+		const DrawItem& next = items[order[end]];
+		if ((keys[end] >> 60) != pass || next.shader != item.shader || next.material != item.material || next.heap != item.heap)
+			break;
+		if (next.range.firstIndex != item.range.firstIndex || next.range.baseVertex != item.range.baseVertex || next.mode != item.mode)
+			break;
+		if (next.condition != item.condition)
+			break;
+		end++;
+	}
+	return end;
+}
+
+void RenderQueue::Flush() {
+	auto start = std::chrono::high_resolution_clock::now();
+	stats = RenderQueueStats();
+	stats.items = (unsigned int)items.size();
+	if (items.empty()) {
+		// an empty flush still uses up the frame's timing
+		for (MaterialTiming& timing : timings)
+			timing.measuring = false;
+		return;
+	}
+
+	radixSort();
+
+	// one upload for the whole frame, runs index into it with their base instance
+	transforms.resize(items.size());
+	for (std::size_t i = 0; i < items.size(); i++)
+		transforms[i] = items[order[i]].model;
+	GLuint baseInstance = Mesh::Instances().Upload(transforms);
+
+	GLboolean blendEnabled = glIsEnabled(GL_BLEND);
+	int timed = -1;
+
+	// depth-only pass over the opaque runs of pre-pass materials, in the same front-to-back order
+	bool prepassed = false;
+	std::size_t i = 0;
+	while (i < items.size()) {
+		const DrawItem& item = items[order[i]];
+		std::size_t end = runEnd(i);
+		if ((keys[i] >> 60) == (uint64_t)RenderPass::Opaque && UsesPrepass(item.material)) {
+			if (!prepassed) {
+				glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+				glDisable(GL_BLEND);
+				glDepthMask(GL_TRUE);
+				depthProgram->use();
+				stats.programSwitches++;
+				prepassed = true;
+			}
+			switchTiming(timed, item.material, 0);
+			if (item.condition)
+				glBeginConditionalRender(item.condition, GL_QUERY_WAIT);
+			item.heap->DrawInstanced(item.range, (GLsizei)(end - i), baseInstance + (GLuint)i, item.mode);
+			if (item.condition)
+				glEndConditionalRender();
+			stats.prepassDraws++;
+		}
+		i = end;
+	}
+	endTiming(timed);
+	if (prepassed)
+		glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+
+	Shader* currentShader = nullptr;
+	unsigned int currentMaterial = ~0u;
+	uint64_t currentPass = ~0ull;
+	bool equalDepth = false;
+
+	i = 0;
+	while (i < items.size()) {
+		const DrawItem& item = items[order[i]];
+		uint64_t pass = keys[i] >> 60;
+		std::size_t end = runEnd(i);
+
+		if (pass != currentPass) {
+			if (pass == (uint64_t)RenderPass::Opaque) {
+				glDisable(GL_BLEND);
+				glDepthMask(GL_TRUE);
+			} else {
+				glEnable(GL_BLEND);
+				glDepthMask(GL_FALSE);
+			}
+			currentPass = pass;
+		}
+		// pre-passed draws only shade the fragments whose depth they already wrote
+		bool equal = pass == (uint64_t)RenderPass::Opaque && UsesPrepass(item.material);
+		if (equal != equalDepth) {
+			glDepthFunc(equal ? GL_EQUAL : GL_LESS);
+			// transparent passes never write depth, whatever the run before them did
+			glDepthMask(equal || pass != (uint64_t)RenderPass::Opaque ? GL_FALSE : GL_TRUE);
+			equalDepth = equal;
+		}
+		if (item.shader != currentShader) {
+			item.shader->use();
+			currentShader = item.shader;
+			currentMaterial = ~0u;
+			stats.programSwitches++;
+		}
+		if (item.material != currentMaterial) {
+			const RenderMaterial& material = materials[item.material];
+			for (std::size_t t = 0; t < material.textures.size(); t++) {
+				glActiveTexture(GL_TEXTURE0 + (GLenum)t);
+				glBindTexture(GL_TEXTURE_2D, material.textures[t]);
+			}
+			glActiveTexture(GL_TEXTURE0);
+			if (material.apply)
+				material.apply(*item.shader);
+			currentMaterial = item.material;
+			stats.materialSwitches++;
+		}
+		if (pass == (uint64_t)RenderPass::Opaque)
+			switchTiming(timed, item.material, 1);
+		else
+			endTiming(timed);
+
+		if (item.condition)
+			glBeginConditionalRender(item.condition, GL_QUERY_WAIT);
+		item.heap->DrawInstanced(item.range, (GLsizei)(end - i), baseInstance + (GLuint)i, item.mode);
+		if (item.condition)
+			glEndConditionalRender();
+		stats.draws++;
+		i = end;
+	}
+	endTiming(timed);
+
+	// only the frame's first flush is timed
+	for (MaterialTiming& timing : timings) {
+		if (timing.measuring && (timing.issued[0] || timing.issued[1]))
+			timing.pending = true;
+		timing.measuring = false;
+	}
+
+	glDepthFunc(GL_LESS);
+	glDepthMask(GL_TRUE);
+	if (blendEnabled)
+		glEnable(GL_BLEND);
+	else
+		glDisable(GL_BLEND);
+
+	auto elapsed = std::chrono::high_resolution_clock::now() - start;
+	stats.submitMilliseconds = std::chrono::duration<double, std::milli>(elapsed).count();
+}
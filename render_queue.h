@@ -0,0 +1,127 @@
+#ifndef RENDER_QUEUE_H
+#define RENDER_QUEUE_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include "shader.h"
+#include "geometry_heap.h"
+
+#include <cstdint>
+#include <functional>
+#include <unordered_map>
+#include <vector>
+
+enum class RenderPass : uint8_t {
+    Opaque,
+    Transparent,
+};
+
+// whether a material's opaque draws lay down depth first with the pre-pass program
+enum class PrepassMode : uint8_t {
+    Off,
+    On,
+    Auto, // timed with and without the pre-pass, keeps whichever is cheaper
+};
+
+// textures bound to units 0..n-1 plus any per-material uniforms
+struct RenderMaterial {
+    std::vector<unsigned int> textures;
+    std::function<void(Shader&)> apply;
+    PrepassMode prepass = PrepassMode::Off;
+};
+
+// submission statistics of the last Flush()
+struct RenderQueueStats {
+    unsigned int items = 0;
+    unsigned int draws = 0;
+    unsigned int prepassDraws = 0;
+    unsigned int programSwitches = 0;
+    unsigned int materialSwitches = 0;
+    double submitMilliseconds = 0.0;
+};
+
+// collects draws for a frame and emits them sorted by a 64-bit key.
+// key layout, high to low bits:
+//   pass (4) | program (8) | material (16) | heap (8) | range (12) | depth (16)    opaque, front to back
+//   pass (4) | depth (24) | program (8) | material (16) | heap (8)                  transparent, back to front
+// consecutive items that only differ in depth and share a range become one instanced draw.
+// opaque items of pre-pass materials are first drawn depth-only, then shaded with GL_EQUAL and
+// depth writes off, so their fragment shader runs once per visible pixel.
+class RenderQueue {
+public:
+    RenderQueue();
+
+    // programs, materials and heaps are referenced by small ids packed into the key
+    unsigned int RegisterMaterial(RenderMaterial material);
+
+    // once per frame before its first Begin: reads back the Auto materials' timings and times the
+    // next Flush. later flushes of the frame draw in the same modes untimed, so a material they
+    // happen to draw alone is not mixed into its average
+    void BeginFrame();
+    // starts a batch of draws, depth is quantised over [0, farPlane] from the eye
+    void Begin(const glm::vec3& eye, float farPlane);
+    // a non-zero condition is an occlusion query, the GPU skips the draw when it saw no samples
+    void Submit(RenderPass pass, Shader& shader, unsigned int material, GeometryHeap& heap,
+        const GeometryRange& range, const glm::mat4& model, GLenum mode = GL_TRIANGLES, GLuint condition = 0);
+    void Flush();
+
+    // position-only program of the depth pre-pass, null turns the pre-pass off for every material.
+    // its gl_Position has to be invariant and computed like the material programs compute theirs.
+    void SetDepthPrepass(Shader* program) { depthProgram = program; }
+    // whether the material's draws currently go through the pre-pass
+    bool UsesPrepass(unsigned int material) const;
+
+    const RenderQueueStats& Stats() const { return stats; }
+private:
+    struct DrawItem {
+        Shader* shader;
+        unsigned int material;
+        GeometryHeap* heap;
+        GeometryRange range;
+        GLenum mode;
+        GLuint condition;
+        glm::mat4 model;
+    };
+
+    // GPU time of one material in a flush, the pre-pass and the main pass are queried separately
+    struct MaterialTiming {
+        GLuint queries[2] = {};
+        bool issued[2] = {};
+        bool measuring = false; // queries may be started during this flush
+        bool pending = false; // waiting for the results
+        bool prepass = false; // the mode Auto currently runs
+        double milliseconds[2] = { -1.0, -1.0 }; // smoothed cost without and with the pre-pass
+        unsigned int samples = 0;
+    };
+
+    std::vector<Shader*> programs;
+    std::vector<RenderMaterial> materials;
+    std::vector<GeometryHeap*> heaps;
+    std::unordered_map<uint64_t, unsigned int> ranges; // first index and base vertex -> key id, per batch
+    std::vector<MaterialTiming> timings; // parallel to materials
+    Shader* depthProgram = nullptr;
+
+    std::vector<uint64_t> keys;
+    std::vector<uint32_t> order;
+    std::vector<DrawItem> items;
+    // sort scratch and the instance transforms in submission order
+    std::vector<uint64_t> keyScratch;
+    std::vector<uint32_t> orderScratch;
+    std::vector<glm::mat4> transforms;
+
+    glm::vec3 eye;
+    float farPlane;
+    RenderQueueStats stats;
+
+    unsigned int programIndex(Shader* shader);
+    unsigned int heapIndex(GeometryHeap* heap);
+    unsigned int rangeIndex(const GeometryRange& range);
+    void radixSort();
+    std::size_t runEnd(std::size_t begin) const;
+    void collectTimings();
+    void switchTiming(int& timed, unsigned int material, int pass);
+    void endTiming(int& timed);
+};
+
+#endif
@@ -0,0 +1,97 @@
+#include "scene_graph.h"
+#include "simd_math.h"
+
+#include <algorithm>
+
+int SceneGraph::CreateNode(int parent, const std::string& name) {
+	int node = (int)parents.size();
+	parents.push_back(parent);
+	names.push_back(name);
+	positions.push_back(glm::vec3(0.0f));
+	rotations.push_back(glm::quat(1.0f, 0.0f, 0.0f, 0.0f));
+	scales.push_back(glm::vec3(1.0f));
+	worlds.push_back(glm::mat4(1.0f));
+	dirty.push_back(1);
+	anyDirty = true;
+	return node;
+}
+
+int SceneGraph::Find(const std::string& name) const {
+	auto it = std::find(names.begin(), names.end(), name);
+	return it == names.end() ? -1 : (int)(it - names.begin());
+}
+
+void SceneGraph::markDirty(int node) {
+	dirty[node] = 1;
+	anyDirty = true;
+}
+
+void SceneGraph::SetPosition(int node, const glm::vec3& position) {
+	positions[node] = position;
+	markDirty(node);
+}
+
+void SceneGraph::SetRotation(int node, const glm::quat& rotation) {
+	rotations[node] = rotation;
+	markDirty(node);
+}
+
+void SceneGraph::SetScale(int node, const glm::vec3& scale) {
+	scales[node] = scale;
+	markDirty(node);
+}
+
+void SceneGraph::SetLocalMatrix(int node, const glm::mat4& local) {
+	glm::vec3 scale(glm::length(glm::vec3(local[0])), glm::length(glm::vec3(local[1])), glm::length(glm::vec3(local[2])));
+	// a mirrored basis keeps its reflection in the scale
+	if (glm::dot(glm::cross(glm::vec3(local[0]), glm::vec3(local[1])), glm::vec3(local[2])) < 0.0f)
+		scale.x = -scale.x;
+
+	// rigs hide parts with a zero scale, such an axis has no direction to divide out. it is completed
+	// from the other two axes, or left at the identity axis when they are degenerate as well
+	glm::vec3 axes[3];
+	for (int k = 0; k < 3; k++)
+		axes[k] = scale[k] != 0.0f ? glm::vec3(local[k]) / scale[k] : glm::vec3(0.0f);
+	for (int k = 0; k < 3; k++) {
+		int a = (k + 1) % 3, b = (k + 2) % 3;
+		if (scale[k] != 0.0f)
+			continue;
+		if (scale[a] != 0.0f && scale[b] != 0.0f)
+			axes[k] = glm::cross(axes[a], axes[b]);
+		else
+			axes[k][k] = 1.0f;
+	}
+
+	glm::mat3 rotation(axes[0], axes[1], axes[2]);
+	positions[node] = glm::vec3(local[3]);
+	rotations[node] = glm::normalize(glm::quat_cast(rotation));
+	scales[node] = scale;
+	markDirty(node);
+}
+
+void SceneGraph::UpdateTransforms() {
+	// nothing moved, static scenes stop here
+	if (!anyDirty)
+		return;
+
+	std::size_t count = parents.size();
+	for (std::size_t i = 0; i < count; i++) {
+		int parent = parents[i];
+		// parents come first, so their flag already includes their own ancestors
+		if (parent >= 0)
+			dirty[i] |= dirty[parent];
+		if (!dirty[i])
+			continue;
+
+		glm::mat4 local = glm::mat4_cast(rotations[i]);
+		local[0] *= scales[i].x;
+		local[1] *= scales[i].y;
+		local[2] *= scales[i].z;
+		local[3] = glm::vec4(positions[i], 1.0f);
+		worlds[i] = parent >= 0 ? MulMat4(worlds[parent], local) : local;
+	}
+
+	std::fill(dirty.begin(), dirty.end(), 0);
+	anyDirty = false;
+	version++;
+}
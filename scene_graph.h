@@ -0,0 +1,53 @@
+#ifndef SCENE_GRAPH_H
+#define SCENE_GRAPH_H
+
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// transform hierarchy kept in flat arrays, parents always before their children.
+// setters only flag the node, UpdateTransforms() then recomputes the world matrices of
+// flagged nodes and their descendants in one forward pass.
+class SceneGraph {
+public:
+    // parent must already exist, -1 for a root
+    int CreateNode(int parent = -1, const std::string& name = "");
+
+    void SetPosition(int node, const glm::vec3& position);
+    void SetRotation(int node, const glm::quat& rotation);
+    void SetScale(int node, const glm::vec3& scale);
+    // splits an affine matrix into translation, rotation and scale (shear is dropped)
+    void SetLocalMatrix(int node, const glm::mat4& local);
+
+    const glm::vec3& Position(int node) const { return positions[node]; }
+    const glm::quat& Rotation(int node) const { return rotations[node]; }
+    const glm::vec3& Scale(int node) const { return scales[node]; }
+    int Parent(int node) const { return parents[node]; }
+    const std::string& Name(int node) const { return names[node]; }
+    int Find(const std::string& name) const;
+
+    // world matrices are only valid after UpdateTransforms()
+    void UpdateTransforms();
+    const glm::mat4& World(int node) const { return worlds[node]; }
+    // bumped whenever UpdateTransforms() changed anything, lets callers cache derived data
+    unsigned int Version() const { return version; }
+
+    unsigned int NodeCount() const { return (unsigned int)parents.size(); }
+private:
+    std::vector<int> parents;
+    std::vector<std::string> names;
+    std::vector<glm::vec3> positions;
+    std::vector<glm::quat> rotations;
+    std::vector<glm::vec3> scales;
+    std::vector<glm::mat4> worlds;
+    std::vector<uint8_t> dirty;
+    bool anyDirty = false;
+    unsigned int version = 0;
+
+    void markDirty(int node);
+};
+
+#endif
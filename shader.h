@@ -52,12 +52,95 @@ public:
             std::cout << "ERROR::SHADER::FILE_NOT_SUCCESSFULLY_READ" << std::endl;
         }
 
-        const char* vShaderCode = vertexCode.c_str();
-        const char* fShaderCode = fragmentCode.c_str();
         const char* gShaderCode = nullptr;
         if (geometryPath) gShaderCode = geometryCode.c_str();
 
         // 2. compile shaders
+        build(vertexCode.c_str(), fragmentCode.c_str(), gShaderCode);
+    }
+    // program from sources put together at run time instead of read from files
+    static Shader FromSource(const std::string& vertexCode, const std::string& fragmentCode) {
+        Shader shader;
+        shader.build(vertexCode.c_str(), fragmentCode.c_str(), nullptr);
+        return shader;
+    }
+    // compute program, needs a 4.3 context
+    explicit Shader(const char* computePath) {
+        std::string computeCode;
+        std::ifstream cShaderFile;
+        cShaderFile.exceptions(std::ifstream::failbit | std::ifstream::badbit);
+        try {
+            cShaderFile.open(computePath);
+            std::stringstream cShaderStream;
+            cShaderStream << cShaderFile.rdbuf();
+            cShaderFile.close();
+            computeCode = cShaderStream.str();
+        } catch (std::ifstream::failure e) {
+            std::cout << "ERROR::SHADER::FILE_NOT_SUCCESSFULLY_READ" << std::endl;
+        }
+        const char* cShaderCode = computeCode.c_str();
+
+        int success;
+        char infoLog[512];
+
+        unsigned int compute = glCreateShader(GL_COMPUTE_SHADER);
+        glShaderSource(compute, 1, &cShaderCode, NULL);
+        glCompileShader(compute);
+        glGetShaderiv(compute, GL_COMPILE_STATUS, &success);
+        if (!success) {
+            glGetShaderInfoLog(compute, 512, NULL, infoLog);
+            std::cout << "ERROR::SHADER::COMPUTE::COMPILATION_FAILED\n" << infoLog << std::endl;
+        }
+
+        ID = glCreateProgram();
+        glAttachShader(ID, compute);
+        glLinkProgram(ID);
+        glGetProgramiv(ID, GL_LINK_STATUS, &success);
+        if (!success) {
+            glGetProgramInfoLog(ID, 512, NULL, infoLog);
+            std::cout << "ERROR::SHADER::PROGRAM::LINKING_FAILED\n" << infoLog << std::endl;
+        }
+        glDeleteShader(compute);
+    }
+    // use/activate the shader
+    void use() {
+        glUseProgram(ID);
+    }
+    // utility uniform functions
+    void setBool(const std::string& name, bool value) const {
+        glUniform1i(glGetUniformLocation(ID, name.c_str()), (int)value);
+    }
+    void setInt(const std::string& name, int value) const {
+        glUniform1i(glGetUniformLocation(ID, name.c_str()), value);
+    }
+    void setFloat(const std::string& name, float value) const {
+        glUniform1f(glGetUniformLocation(ID, name.c_str()), value);
+    }
+    void setVec2(const std::string& name, float v0, float v1) const {
+        glUniform2f(glGetUniformLocation(ID, name.c_str()), v0, v1);
+    }
+    void setIVec3(const std::string& name, int v0, int v1, int v2) const {
+        glUniform3i(glGetUniformLocation(ID, name.c_str()), v0, v1, v2);
+    }
+    void setMat4(const std::string& name, const glm::mat4& value) const {
+        glUniformMatrix4fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, glm::value_ptr(value));
+    }
+    void setVec3(const std::string& name, float v0, float v1, float v2) const {
+        glUniform3f(glGetUniformLocation(ID, name.c_str()), v0, v1, v2);
+    }
+    void setVec3(const std::string& name, const glm::vec3 value) const {
+        glUniform3f(glGetUniformLocation(ID, name.c_str()), value.x, value.y, value.z);
+    }
+    void setVec4(const std::string& name, float v0, float v1, float v2, float v3) const {
+        glUniform4f(glGetUniformLocation(ID, name.c_str()), v0, v1, v2, v3);
+    }
+    void setVec4(const std::string& name, const glm::vec4 value) const {
+        glUniform4f(glGetUniformLocation(ID, name.c_str()), value.x, value.y, value.z, value.w);
+    }
+private:
+    Shader() : ID(0) {}
+
+    void build(const char* vShaderCode, const char* fShaderCode, const char* gShaderCode) {
         unsigned int vertex, fragment, geometry;
         int success;
         char infoLog[512];
@@ -115,35 +198,6 @@ public:
         glDeleteShader(fragment);
         if (gShaderCode) glDeleteShader(geometry);
     }
-    // use/activate the shader
-    void use() {
-        glUseProgram(ID);
-    }
-    // utility uniform functions
-    void setBool(const std::string& name, bool value) const {
-        glUniform1i(glGetUniformLocation(ID, name.c_str()), (int)value);
-    }
-    void setInt(const std::string& name, int value) const {
-        glUniform1i(glGetUniformLocation(ID, name.c_str()), value);
-    }
-    void setFloat(const std::string& name, float value) const {
-        glUniform1f(glGetUniformLocation(ID, name.c_str()), value);
-    }
-    void setMat4(const std::string& name, const glm::mat4& value) const {
-        glUniformMatrix4fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, glm::value_ptr(value));
-    }
-    void setVec3(const std::string& name, float v0, float v1, float v2) const {
-        glUniform3f(glGetUniformLocation(ID, name.c_str()), v0, v1, v2);
-    }
-    void setVec3(const std::string& name, const glm::vec3 value) const {
-        glUniform3f(glGetUniformLocation(ID, name.c_str()), value.x, value.y, value.z);
-    }
-    void setVec4(const std::string& name, float v0, float v1, float v2, float v3) const {
-        glUniform4f(glGetUniformLocation(ID, name.c_str()), v0, v1, v2, v3);
-    }
-    void setVec4(const std::string& name, const glm::vec4 value) const {
-        glUniform4f(glGetUniformLocation(ID, name.c_str()), value.x, value.y, value.z, value.w);
-    }
 };
 
 #endif
\ No newline at end of file
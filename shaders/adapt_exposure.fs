@@ -0,0 +1,15 @@
+#version 330 core
+layout (location = 0) out vec4 AdaptedLuminance;
+
+uniform sampler2D logLuminance; // with its mip chain built
+uniform sampler2D previousLuminance;
+uniform int topLevel;
+uniform float adaptation; // share of the way covered this frame
+
+void main() {
+    float average = texelFetch(logLuminance, ivec2(0), topLevel).r;
+    // adapted in log space, the eye reacts to ratios. 0 means nothing was measured yet
+    float previous = texelFetch(previousLuminance, ivec2(0), 0).r;
+    float adapted = previous > 0.0 ? mix(log2(previous), average, adaptation) : average;
+    AdaptedLuminance = vec4(exp2(adapted));
+}
@@ -0,0 +1,50 @@
+#version 330 core
+layout (location = 0) out vec4 FragColor;
+
+uniform sampler2D source;
+uniform vec2 sourceTexelSize;
+uniform vec2 targetTexelSize;
+uniform bool karisAverage;
+
+float luminance(vec3 color) {
+    return dot(color, vec3(0.2126, 0.7152, 0.0722));
+}
+
+// 13 bilinear taps around the target texel's centre, read as five overlapping 2x2 boxes:
+// the four corner boxes and the centre one, which gets half the total weight
+void main() {
+    vec2 uv = gl_FragCoord.xy * targetTexelSize;
+    vec2 t = sourceTexelSize;
+
+    vec3 a = texture(source, uv + t * vec2(-2.0,  2.0)).rgb;
+    vec3 b = texture(source, uv + t * vec2( 0.0,  2.0)).rgb;
+    vec3 c = texture(source, uv + t * vec2( 2.0,  2.0)).rgb;
+    vec3 d = texture(source, uv + t * vec2(-2.0,  0.0)).rgb;
+    vec3 e = texture(source, uv).rgb;
+    vec3 f = texture(source, uv + t * vec2( 2.0,  0.0)).rgb;
+    vec3 g = texture(source, uv + t * vec2(-2.0, -2.0)).rgb;
+    vec3 h = texture(source, uv + t * vec2( 0.0, -2.0)).rgb;
+    vec3 i = texture(source, uv + t * vec2( 2.0, -2.0)).rgb;
+    vec3 j = texture(source, uv + t * vec2(-1.0,  1.0)).rgb;
+    vec3 k = texture(source, uv + t * vec2( 1.0,  1.0)).rgb;
+    vec3 l = texture(source, uv + t * vec2(-1.0, -1.0)).rgb;
+    vec3 m = texture(source, uv + t * vec2( 1.0, -1.0)).rgb;
+
+    vec3 boxes[5] = vec3[](
+        (a + b + d + e) * 0.25, (b + c + e + f) * 0.25,
+        (d + e + g + h) * 0.25, (e + f + h + i) * 0.25,
+        (j + k + l + m) * 0.25);
+    float weights[5] = float[](0.125, 0.125, 0.125, 0.125, 0.5);
+
+    vec3 result = vec3(0.0);
+    float total = 0.0;
+    for (int n = 0; n < 5; n++) {
+        float w = weights[n];
+        if (karisAverage)
+            w /= 1.0 + luminance(boxes[n]);
+        result += boxes[n] * w;
+        total += w;
+    }
+
+    FragColor = vec4(max(result / total, 0.0), 1.0);
+}
@@ -0,0 +1,21 @@
+#version 330 core
+layout (location = 0) out vec4 FragColor;
+
+uniform sampler2D source;
+uniform vec2 sourceTexelSize;
+uniform vec2 targetTexelSize;
+uniform float radius; // in source texels
+
+// 3x3 tent, added onto the target by the blend state
+void main() {
+    vec2 uv = gl_FragCoord.xy * targetTexelSize;
+    vec2 t = sourceTexelSize * radius;
+
+    vec3 result = texture(source, uv).rgb * 4.0;
+    result += (texture(source, uv + vec2(-t.x, 0.0)).rgb + texture(source, uv + vec2(t.x, 0.0)).rgb
+        + texture(source, uv + vec2(0.0, -t.y)).rgb + texture(source, uv + vec2(0.0, t.y)).rgb) * 2.0;
+    result += texture(source, uv + vec2(-t.x, -t.y)).rgb + texture(source, uv + vec2(t.x, -t.y)).rgb
+        + texture(source, uv + vec2(-t.x, t.y)).rgb + texture(source, uv + vec2(t.x, t.y)).rgb;
+
+    FragColor = vec4(result / 16.0, 1.0);
+}
@@ -0,0 +1,101 @@
+#version 330 core
+layout (location = 0) out vec4 FragColor;
+layout (location = 1) out vec4 BrightColor;
+
+struct Light { 
+    vec3 position;
+    vec3 color;
+    float radius;
+};
+
+// G-buffer written by gbuffer.fs
+uniform sampler2D gAlbedo;
+uniform sampler2D gNormal;
+uniform sampler2D gDepth;
+
+// clustered lights, see clustered_lights.h
+uniform samplerBuffer lightData;     // two texels per light: position and radius, color
+uniform usamplerBuffer lightGrid;    // first index and count per cluster
+uniform usamplerBuffer lightIndices;
+uniform ivec3 clusterCount;          // tiles x, tiles y, depth slices
+uniform vec2 clusterTileSize;        // in pixels
+uniform float clusterNear;
+uniform float clusterSliceScale;     // slices / log(far / near)
+
+uniform mat4 view;
+uniform mat4 inverseViewProjection;
+uniform vec3 viewPos;
+
+vec3 CalcPointLight(Light light, vec3 albedo, vec3 normal, vec3 fragPos, vec3 viewDir);
+
+vec3 decodeNormal(vec2 e) {
+    vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+    if (n.z < 0.0)
+        n.xy = (1.0 - abs(n.yx)) * vec2(n.x >= 0.0 ? 1.0 : -1.0, n.y >= 0.0 ? 1.0 : -1.0);
+    return normalize(n);
+}
+
+int clusterIndex(float viewDepth) {
+    ivec2 tile = min(ivec2(gl_FragCoord.xy / clusterTileSize), clusterCount.xy - 1);
+    int slice = clamp(int(log(max(viewDepth / clusterNear, 1.0)) * clusterSliceScale), 0, clusterCount.z - 1);
+    return tile.x + clusterCount.x * (tile.y + clusterCount.y * slice);
+}
+
+void main()
+{
+    ivec2 pixel = ivec2(gl_FragCoord.xy);
+    float depth = texelFetch(gDepth, pixel, 0).r;
+    // nothing drawn here, keep the cleared background
+    if (depth == 1.0)
+        discard;
+
+    // world position back from the depth buffer
+    vec2 uv = gl_FragCoord.xy / vec2(textureSize(gDepth, 0));
+    vec4 world = inverseViewProjection * vec4(vec3(uv, depth) * 2.0 - 1.0, 1.0);
+    vec3 fragPos = world.xyz / world.w;
+    float viewDepth = -(view * vec4(fragPos, 1.0)).z;
+
+    vec3 albedo = texelFetch(gAlbedo, pixel, 0).rgb;
+    vec3 norm = decodeNormal(texelFetch(gNormal, pixel, 0).xy);
+    vec3 viewDir = normalize(viewPos - fragPos);
+
+    vec3 result = vec3(0.0);
+    uvec2 cluster = texelFetch(lightGrid, clusterIndex(viewDepth)).xy;
+    for (uint i = 0u; i < cluster.y; i++) {
+        int index = int(texelFetch(lightIndices, int(cluster.x + i)).r);
+        Light light;
+        vec4 positionRadius = texelFetch(lightData, 2 * index);
+        light.position = positionRadius.xyz;
+        light.radius = positionRadius.w;
+        light.color = texelFetch(lightData, 2 * index + 1).rgb;
+        result += CalcPointLight(light, albedo, norm, fragPos, viewDir);
+    }
+
+    FragColor = vec4(result, 1.0);
+
+    float brightness = dot(FragColor.rgb, vec3(0.2126, 0.7152, 0.0722));
+    if (brightness > 0.1)
+        BrightColor = vec4(FragColor.rgb, 1.0);
+    else
+        BrightColor = vec4(0.0, 0.0, 0.0, 1.0);
+}
+
+// same terms as hdr_lighting.fs with the albedo read from the G-buffer
+vec3 CalcPointLight(Light light, vec3 albedo, vec3 normal, vec3 fragPos, vec3 viewDir) {
+    vec3 lightDir = normalize(light.position - fragPos);
+
+    // diffuse
+    float diff = max(dot(normal, lightDir), 0.0);
+
+    // attenuation
+    float dist = length(light.position - fragPos);
+    float attenuation = 1.0 / (dist * dist);
+    // windowed so the falloff reaches zero at the light's radius instead of never
+    float window = clamp(1.0 - pow(dist / light.radius, 4.0), 0.0, 1.0);
+    attenuation *= window * window;
+
+    // combine results
+    vec3 diffuse = light.color * diff * albedo;
+
+    return diffuse * attenuation;
+}
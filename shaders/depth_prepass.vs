@@ -0,0 +1,17 @@
+#version 330 core
+
+layout (location = 0) in vec3 aPos;
+// per-instance transform
+layout (location = 4) in mat4 aModel;
+
+// must match hdr_lighting.vs bit for bit, the main pass depth test is GL_EQUAL
+invariant gl_Position;
+
+uniform mat4 view;
+uniform mat4 projection;
+
+void main()
+{
+    vec3 fragPos = vec3(aModel * vec4(aPos, 1.0f));
+    gl_Position = projection * view * vec4(fragPos, 1.0f);
+}
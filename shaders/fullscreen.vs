@@ -0,0 +1,7 @@
+#version 330 core
+// fullscreen triangle generated from the vertex id, no vertex buffer bound
+
+void main() {
+    vec2 position = vec2((gl_VertexID << 1) & 2, gl_VertexID & 2);
+    gl_Position = vec4(position * 2.0 - 1.0, 0.0, 1.0);
+}
@@ -1,27 +1,28 @@
 #version 330 core
 layout (location = 0) out vec4 FragColor;
 
-in vec2 TexCoords;
+// at most GaussianBlur::MAX_TAPS
+const int MAX_TAPS = 16;
 
 uniform sampler2D image;
-  
+
 uniform bool horizontal;
-uniform float weight[5] = float[] (0.227027, 0.1945946, 0.1216216, 0.054054, 0.016216);
+// one side of the kernel from gaussian_blur.cpp, tap 0 is the centre. the other offsets sit
+// between two texels, so one linear fetch returns both texels' weighted sum.
+uniform int tapCount;
+uniform float offsets[MAX_TAPS];
+uniform float weights[MAX_TAPS];
 
 void main() {
-	vec2 tex_offset = 1.0 / textureSize(image, 0);
-	vec3 result = texture(image, TexCoords).rgb * weight[0];
-	if (horizontal) {
-		for (int i = 1; i < 5; ++i) {
-			result += texture(image, TexCoords + vec2(tex_offset.x * i, 0.0)).rgb * weight[i];
-			result += texture(image, TexCoords - vec2(tex_offset.x * i, 0.0)).rgb * weight[i];
-		}
-	} else {
-		for (int i = 1; i < 5; ++i) {
-			result += texture(image, TexCoords + vec2(0.0, tex_offset.y * i)).rgb * weight[i];
-			result += texture(image, TexCoords - vec2(0.0, tex_offset.y * i)).rgb * weight[i];
-		}
+	vec2 texelSize = 1.0 / textureSize(image, 0);
+	vec2 uv = gl_FragCoord.xy * texelSize;
+	vec2 direction = horizontal ? vec2(texelSize.x, 0.0) : vec2(0.0, texelSize.y);
+
+	vec3 result = texture(image, uv).rgb * weights[0];
+	for (int i = 1; i < tapCount; ++i) {
+		result += texture(image, uv + direction * offsets[i]).rgb * weights[i];
+		result += texture(image, uv - direction * offsets[i]).rgb * weights[i];
 	}
 
 	FragColor = vec4(result, 1.0);
-}
\ No newline at end of file
+}
@@ -0,0 +1,24 @@
+#version 330 core
+in vec3 Normal;
+in vec3 FragPos;
+in vec2 TexCoords;
+
+layout (location = 0) out vec4 Albedo;
+layout (location = 1) out vec2 EncodedNormal;
+
+uniform sampler2D diffuse;
+
+// octahedral mapping: the unit sphere folded onto [-1, 1]^2, lower hemisphere into the corners
+vec2 encodeNormal(vec3 n) {
+    n /= abs(n.x) + abs(n.y) + abs(n.z);
+    if (n.z >= 0.0)
+        return n.xy;
+    vec2 signs = vec2(n.x >= 0.0 ? 1.0 : -1.0, n.y >= 0.0 ? 1.0 : -1.0);
+    return (1.0 - abs(n.yx)) * signs;
+}
+
+void main()
+{
+    Albedo = vec4(texture(diffuse, TexCoords).rgb, 1.0);
+    EncodedNormal = encodeNormal(normalize(Normal));
+}
@@ -2,6 +2,7 @@
 in vec3 Normal;
 in vec3 FragPos;
 in vec2 TexCoords;
+in float ViewDepth;
 
 layout (location = 0) out vec4 FragColor;
 layout (location = 1) out vec4 BrightColor;
@@ -9,14 +10,29 @@ layout (location = 1) out vec4 BrightColor;
 struct Light { 
     vec3 position;
     vec3 color;
+    float radius;
 };
-uniform Light lights[4];
+
+// clustered lights, see clustered_lights.h
+uniform samplerBuffer lightData;     // two texels per light: position and radius, color
+uniform usamplerBuffer lightGrid;    // first index and count per cluster
+uniform usamplerBuffer lightIndices;
+uniform ivec3 clusterCount;          // tiles x, tiles y, depth slices
+uniform vec2 clusterTileSize;        // in pixels
+uniform float clusterNear;
+uniform float clusterSliceScale;     // slices / log(far / near)
 
 uniform sampler2D diffuse;
 uniform vec3 viewPos;
 
 vec3 CalcPointLight(Light light, vec3 normal, vec3 fragPos, vec3 viewDir);
 
+int clusterIndex() {
+    ivec2 tile = min(ivec2(gl_FragCoord.xy / clusterTileSize), clusterCount.xy - 1);
+    int slice = clamp(int(log(max(ViewDepth / clusterNear, 1.0)) * clusterSliceScale), 0, clusterCount.z - 1);
+    return tile.x + clusterCount.x * (tile.y + clusterCount.y * slice);
+}
+
 void main()
 {
     vec3 norm = normalize(Normal);
@@ -25,9 +41,16 @@ void main()
     vec3 result = vec3(0.0);
     // phase 1: Directional lighting
     // vec3 result = CalcDirLight(dirLight, norm, viewDir);
-    // phase 2: Point lights
-    for (int i = 0; i < 4; i++) {
-        result += CalcPointLight(lights[i], norm, FragPos, viewDir);
+    // phase 2: Point lights, only the ones reaching this fragment's cluster
+    uvec2 cluster = texelFetch(lightGrid, clusterIndex()).xy;
+    for (uint i = 0u; i < cluster.y; i++) {
+        int index = int(texelFetch(lightIndices, int(cluster.x + i)).r);
+        Light light;
+        vec4 positionRadius = texelFetch(lightData, 2 * index);
+        light.position = positionRadius.xyz;
+        light.radius = positionRadius.w;
+        light.color = texelFetch(lightData, 2 * index + 1).rgb;
+        result += CalcPointLight(light, norm, FragPos, viewDir);
     }
     // phase 3: Spot light
     // todo
@@ -51,6 +74,9 @@ vec3 CalcPointLight(Light light, vec3 normal, vec3 fragPos, vec3 viewDir) {
     // attenuation
     float dist = length(light.position - fragPos);
     float attenuation = 1.0 / (dist * dist);
+    // windowed so the falloff reaches zero at the light's radius instead of never
+    float window = clamp(1.0 - pow(dist / light.radius, 4.0), 0.0, 1.0);
+    attenuation *= window * window;
 
     // combine results
     vec3 diffuse = light.color * diff * color;
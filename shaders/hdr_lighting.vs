@@ -3,12 +3,18 @@
 layout (location = 0) in vec3 aPos;
 layout (location = 1) in vec3 aNormal;
 layout (location = 2) in vec2 aTexCoords;
+// per-instance transforms
+layout (location = 4) in mat4 aModel;
+layout (location = 8) in mat3 aNormalMatrix;
 
 out vec3 Normal;
 out vec3 FragPos;
 out vec2 TexCoords;
+out float ViewDepth;
+
+// reproduced exactly by depth_prepass.vs
+invariant gl_Position;
 
-uniform mat4 model;
 uniform mat4 view;
 uniform mat4 projection;
 
@@ -18,13 +24,14 @@ void main()
 {
     TexCoords = aTexCoords;
 
-    gl_Position = projection * view * model * vec4(aPos, 1.0f);
-    FragPos = vec3(model * vec4(aPos, 1.0f));
+    FragPos = vec3(aModel * vec4(aPos, 1.0f));
+    gl_Position = projection * view * vec4(FragPos, 1.0f);
+    ViewDepth = -(view * vec4(FragPos, 1.0f)).z;
 
     vec3 normal = aNormal;
 
     if (inverseNormal)
         normal = -normal;
 
-    Normal = mat3(transpose(inverse(model))) * normal;
+    Normal = aNormalMatrix * normal;
 }
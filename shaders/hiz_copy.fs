@@ -0,0 +1,8 @@
+#version 330 core
+out float FragColor;
+
+uniform sampler2D depth;
+
+void main() {
+    FragColor = texelFetch(depth, ivec2(gl_FragCoord.xy), 0).r;
+}
@@ -0,0 +1,37 @@
+#version 330 core
+out float FragColor;
+
+// only the previous level is accessible, lod 0 reads it
+uniform sampler2D previous;
+
+ivec2 previousSize;
+
+// a level 1 texel wide or tall halves to 1, not 0, so the second texel can be past the edge
+float fetch(ivec2 texel) {
+    return texelFetch(previous, min(texel, previousSize - 1), 0).r;
+}
+
+void main() {
+    previousSize = textureSize(previous, 0);
+    ivec2 coord = ivec2(gl_FragCoord.xy);
+    ivec2 source = coord * 2;
+
+    float depth = max(max(fetch(source), fetch(source + ivec2(1, 0))),
+                      max(fetch(source + ivec2(0, 1)), fetch(source + ivec2(1, 1))));
+
+    // odd sizes: the last column and row also cover the texels the halving dropped
+    bool extraColumn = (previousSize.x & 1) != 0 && coord.x == previousSize.x / 2 - 1;
+    bool extraRow = (previousSize.y & 1) != 0 && coord.y == previousSize.y / 2 - 1;
+    if (extraColumn) {
+        depth = max(depth, fetch(source + ivec2(2, 0)));
+        depth = max(depth, fetch(source + ivec2(2, 1)));
+    }
+    if (extraRow) {
+        depth = max(depth, fetch(source + ivec2(0, 2)));
+        depth = max(depth, fetch(source + ivec2(1, 2)));
+    }
+    if (extraColumn && extraRow)
+        depth = max(depth, fetch(source + ivec2(2, 2)));
+
+    FragColor = depth;
+}
@@ -0,0 +1,10 @@
+#version 330 core
+flat in int visible;
+
+out float FragColor;
+
+void main() {
+    if (visible == 0)
+        discard;
+    FragColor = 1.0;
+}
@@ -0,0 +1,54 @@
+#version 330 core
+layout (location = 0) in vec3 aBoundsMin;
+layout (location = 1) in vec3 aBoundsMax;
+
+flat out int visible;
+
+uniform mat4 viewProjection;
+uniform sampler2D hiz;
+uniform int levels;
+uniform int visibilityWidth;
+uniform int visibilityHeight;
+
+int testBounds() {
+    vec3 screenMin = vec3(1.0);
+    vec3 screenMax = vec3(0.0);
+    for (int i = 0; i < 8; ++i) {
+        vec3 corner = vec3((i & 1) != 0 ? aBoundsMax.x : aBoundsMin.x,
+                           (i & 2) != 0 ? aBoundsMax.y : aBoundsMin.y,
+                           (i & 4) != 0 ? aBoundsMax.z : aBoundsMin.z);
+        vec4 clip = viewProjection * vec4(corner, 1.0);
+        // crosses the near plane, the projected rectangle would be meaningless
+        if (clip.z < -clip.w)
+            return 1;
+        vec3 ndc = clip.xyz / clip.w * 0.5 + 0.5;
+        screenMin = min(screenMin, ndc);
+        screenMax = max(screenMax, ndc);
+    }
+
+    screenMin.xy = clamp(screenMin.xy, 0.0, 1.0);
+    screenMax.xy = clamp(screenMax.xy, 0.0, 1.0);
+    if (any(greaterThanEqual(screenMin.xy, screenMax.xy)) || screenMin.z > 1.0)
+        return 0;
+
+    // the level where the rectangle spans at most two texels each way, four fetches cover it.
+    // texel coordinates come from the level 0 pixels so odd level sizes can't shift them
+    ivec2 baseSize = textureSize(hiz, 0);
+    vec2 size = (screenMax.xy - screenMin.xy) * vec2(baseSize);
+    int level = clamp(int(ceil(log2(max(max(size.x, size.y), 1.0)))), 0, levels - 1);
+    ivec2 last = textureSize(hiz, level) - 1;
+    ivec2 texelMin = min(ivec2(screenMin.xy * vec2(baseSize)) >> level, last);
+    ivec2 texelMax = min(ivec2(screenMax.xy * vec2(baseSize)) >> level, last);
+
+    float farthest = max(max(texelFetch(hiz, texelMin, level).r, texelFetch(hiz, ivec2(texelMax.x, texelMin.y), level).r),
+                         max(texelFetch(hiz, ivec2(texelMin.x, texelMax.y), level).r, texelFetch(hiz, texelMax, level).r));
+    return screenMin.z <= farthest ? 1 : 0;
+}
+
+void main() {
+    visible = testBounds();
+
+    // one texel of the visibility target per object
+    vec2 texel = vec2(gl_VertexID % visibilityWidth, gl_VertexID / visibilityWidth) + 0.5;
+    gl_Position = vec4(texel / vec2(visibilityWidth, visibilityHeight) * 2.0 - 1.0, 0.0, 1.0);
+}
@@ -0,0 +1,14 @@
+#version 330 core
+layout (location = 0) out vec4 LogLuminance;
+
+uniform sampler2D hdrBuffer;
+uniform float minLogLuminance;
+uniform float maxLogLuminance;
+uniform vec2 targetTexelSize;
+
+// clamped to the range so a few lights or black pixels can't dominate the mip average
+void main() {
+    vec2 uv = gl_FragCoord.xy * targetTexelSize;
+    float luminance = dot(texture(hdrBuffer, uv).rgb, vec3(0.2126, 0.7152, 0.0722));
+    LogLuminance = vec4(clamp(log2(max(luminance, 1e-5)), minLogLuminance, maxLogLuminance));
+}
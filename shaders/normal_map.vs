@@ -3,6 +3,9 @@ layout (location = 0) in vec3 aPos;
 layout (location = 1) in vec3 aNormal;
 layout (location = 2) in vec2 aTexCoords;
 layout (location = 3) in vec3 aTangent;
+// per-instance transforms
+layout (location = 4) in mat4 aModel;
+layout (location = 8) in mat3 aNormalMatrix;
 
 out VS_OUT {
     vec3 FragPos;
@@ -15,7 +18,6 @@ out VS_OUT {
 
 uniform mat4 projection;
 uniform mat4 view;
-uniform mat4 model;
 
 uniform vec3 lightPos;
 uniform vec3 viewPos;
@@ -23,16 +25,15 @@ uniform float farPlane;
 uniform bool useNormalMap;
 
 void main() {
-    vs_out.FragPos = vec3(model * vec4(aPos, 1.0));
+    vs_out.FragPos = vec3(aModel * vec4(aPos, 1.0));
     vs_out.TexCoords = aTexCoords;
-    gl_Position = projection * view * model * vec4(aPos, 1.0f);
+    gl_Position = projection * view * vec4(vs_out.FragPos, 1.0f);
 
-    mat3 normalMatrix = transpose(inverse(mat3(model)));
-    vec3 N = normalize(normalMatrix * aNormal);
+    vec3 N = normalize(aNormalMatrix * aNormal);
     vs_out.Normal = N;
 
     if (useNormalMap) {
-        vec3 T = normalize(normalMatrix * aTangent);
+        vec3 T = normalize(aNormalMatrix * aTangent);
         // re-orthogonalize T with respect to N
         T = normalize(T - dot(T, N) * N);
         // then retrieve perpendicular vector B with the cross product of T and N
@@ -0,0 +1,45 @@
+#version 330 core
+
+layout (location = 0) in vec3 aPos;
+layout (location = 1) in vec3 aNormal;
+layout (location = 2) in vec2 aTexCoords;
+// per-instance transforms
+layout (location = 4) in mat4 aModel;
+layout (location = 8) in mat3 aNormalMatrix;
+// up to four bone influences
+layout (location = 11) in ivec4 aBoneIds;
+layout (location = 12) in vec4 aWeights;
+
+out vec3 Normal;
+out vec3 FragPos;
+out vec2 TexCoords;
+
+uniform mat4 view;
+uniform mat4 projection;
+
+// one palette of boneCount matrices per instance, four texels per matrix
+uniform samplerBuffer bonePalette;
+uniform int boneCount;
+
+mat4 boneMatrix(int bone) {
+    int base = (gl_InstanceID * boneCount + bone) * 4;
+    return mat4(texelFetch(bonePalette, base),
+                texelFetch(bonePalette, base + 1),
+                texelFetch(bonePalette, base + 2),
+                texelFetch(bonePalette, base + 3));
+}
+
+void main()
+{
+    mat4 skin = boneMatrix(aBoneIds.x) * aWeights.x
+              + boneMatrix(aBoneIds.y) * aWeights.y
+              + boneMatrix(aBoneIds.z) * aWeights.z
+              + boneMatrix(aBoneIds.w) * aWeights.w;
+
+    TexCoords = aTexCoords;
+
+    FragPos = vec3(aModel * skin * vec4(aPos, 1.0f));
+    gl_Position = projection * view * vec4(FragPos, 1.0f);
+
+    Normal = aNormalMatrix * mat3(skin) * aNormal;
+}
@@ -0,0 +1,157 @@
+#ifndef SIMD_KERNELS_H
+#define SIMD_KERNELS_H
+
+#include "simd_math.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define SIMD_X86
+#elif defined(__ARM_NEON) || defined(_M_ARM64)
+#define SIMD_NEON
+#endif
+
+// lane-generic kernels shared by the per-instruction-set translation units.
+// a lane type L provides V (with + - * /), WIDTH, Set1, Neg, Abs, Max, Load, Store,
+// LessEqual (one bit per lane) and Gather/Scatter for reading matrices laid out array-of-structures.
+// kernels process [begin, end) in steps of WIDTH and return where they stopped.
+
+struct ScalarLanes {
+    using V = float;
+    static const std::size_t WIDTH = 1;
+
+    static V Set1(float s) { return s; }
+    static V Neg(V a) { return -a; }
+    static V Abs(V a) { return std::fabs(a); }
+    static V Max(V a, V b) { return std::max(a, b); }
+    static unsigned int LessEqual(V a, V b) { return a <= b ? 1u : 0u; }
+    static V Load(const float* p) { return *p; }
+    static void Store(float* p, V a) { *p = a; }
+    static V Gather(const float* p, std::size_t) { return *p; }
+    static void Scatter(float* p, std::size_t, V a) { *p = a; }
+};
+
+template <typename L>
+std::size_t NormalMatricesKernel(const glm::mat4* models, glm::mat3* out, std::size_t begin, std::size_t end) {
+    using V = typename L::V;
+    std::size_t i = begin;
+    for (; i + L::WIDTH <= end; i += L::WIDTH) {
+        const float* src = reinterpret_cast<const float*>(models + i);
+        V m[3][3];
+        for (int c = 0; c < 3; c++) {
+            for (int r = 0; r < 3; r++)
+                m[c][r] = L::Gather(src + c * 4 + r, 16);
+        }
+
+        // same expressions as glm::inverse(mat3), stored transposed
+        V det = m[0][0] * (m[1][1] * m[2][2] - m[2][1] * m[1][2])
+            - m[1][0] * (m[0][1] * m[2][2] - m[2][1] * m[0][2])
+            + m[2][0] * (m[0][1] * m[1][2] - m[1][1] * m[0][2]);
+        V inv = L::Set1(1.0f) / det;
+
+        V n[3][3];
+        n[0][0] = (m[1][1] * m[2][2] - m[2][1] * m[1][2]) * inv;
+        n[0][1] = L::Neg(m[1][0] * m[2][2] - m[2][0] * m[1][2]) * inv;
+        n[0][2] = (m[1][0] * m[2][1] - m[2][0] * m[1][1]) * inv;
+        n[1][0] = L::Neg(m[0][1] * m[2][2] - m[2][1] * m[0][2]) * inv;
+        n[1][1] = (m[0][0] * m[2][2] - m[2][0] * m[0][2]) * inv;
+        n[1][2] = L::Neg(m[0][0] * m[2][1] - m[2][0] * m[0][1]) * inv;
+        n[2][0] = (m[0][1] * m[1][2] - m[1][1] * m[0][2]) * inv;
+        n[2][1] = L::Neg(m[0][0] * m[1][2] - m[1][0] * m[0][2]) * inv;
+        n[2][2] = (m[0][0] * m[1][1] - m[1][0] * m[0][1]) * inv;
+
+        float* dst = reinterpret_cast<float*>(out + i);
+        for (int c = 0; c < 3; c++) {
+            for (int r = 0; r < 3; r++)
+                L::Scatter(dst + c * 3 + r, 9, n[c][r]);
+        }
+    }
+    return i;
+}
+
+// component arrays of an AABBArray
+struct AABBPointers {
+    const float* mins[3];
+    const float* maxs[3];
+    float* outMins[3];
+    float* outMaxs[3];
+};
+
+// center/extent form: the new extent is the absolute linear part applied to the old one
+template <typename L>
+std::size_t TransformAABBsKernel(const AABBPointers& boxes, const glm::mat4* transforms, std::size_t begin, std::size_t end) {
+    using V = typename L::V;
+    std::size_t i = begin;
+    for (; i + L::WIDTH <= end; i += L::WIDTH) {
+        V half = L::Set1(0.5f);
+        V center[3], extent[3];
+        for (int k = 0; k < 3; k++) {
+            V lo = L::Load(boxes.mins[k] + i);
+            V hi = L::Load(boxes.maxs[k] + i);
+            center[k] = (lo + hi) * half;
+            extent[k] = (hi - lo) * half;
+        }
+
+        const float* src = reinterpret_cast<const float*>(transforms + i);
+        for (int r = 0; r < 3; r++) {
+            V m0 = L::Gather(src + r, 16);
+            V m1 = L::Gather(src + 4 + r, 16);
+            V m2 = L::Gather(src + 8 + r, 16);
+            V t = L::Gather(src + 12 + r, 16);
+
+            V c = m0 * center[0] + m1 * center[1] + m2 * center[2] + t;
+            V e = L::Abs(m0) * extent[0] + L::Abs(m1) * extent[1] + L::Abs(m2) * extent[2];
+            L::Store(boxes.outMins[r] + i, c - e);
+            L::Store(boxes.outMaxs[r] + i, c + e);
+        }
+    }
+    return i;
+}
+
+// squared distance from the sphere centre to each box against the squared radius.
+// per axis at most one of the two gaps is positive.
+template <typename L>
+std::size_t SphereOverlapsAABBsKernel(const AABBPointers& boxes, const glm::vec3& center, float radius,
+    uint8_t* hits, std::size_t begin, std::size_t end) {
+    using V = typename L::V;
+    V zero = L::Set1(0.0f);
+    V radiusSq = L::Set1(radius * radius);
+    V c[3] = { L::Set1(center.x), L::Set1(center.y), L::Set1(center.z) };
+
+    std::size_t i = begin;
+    for (; i + L::WIDTH <= end; i += L::WIDTH) {
+        V distanceSq = zero;
+        for (int k = 0; k < 3; k++) {
+            V gap = L::Max(L::Load(boxes.mins[k] + i) - c[k], zero) + L::Max(c[k] - L::Load(boxes.maxs[k] + i), zero);
+            distanceSq = distanceSq + gap * gap;
+        }
+        unsigned int mask = L::LessEqual(distanceSq, radiusSq);
+        for (std::size_t lane = 0; lane < L::WIDTH; lane++)
+            hits[i + lane] = (uint8_t)((mask >> lane) & 1u);
+    }
+    return i;
+}
+
+#ifdef SIMD_X86
+struct OccluderTriangle;
+
+// built in the *_avx2.cpp files, the only ones compiled with AVX2 enabled.
+// only called once ActiveSimdLevel() reported AVX2. just raw pointers cross over, so no
+// inline function shared with other files gets an AVX copy the linker could pick.
+namespace avx2 {
+    void MulMat4(const glm::mat4* a, std::size_t aStep, const glm::mat4* b, glm::mat4* out, std::size_t count);
+    std::size_t NormalMatrices(const glm::mat4* models, glm::mat3* out, std::size_t count);
+    std::size_t TransformAABBs(const AABBPointers& boxes, const glm::mat4* transforms, std::size_t count);
+    std::size_t SphereOverlapsAABBs(const AABBPointers& boxes, const glm::vec3& center, float radius,
+        uint8_t* hits, std::size_t begin, std::size_t end);
+
+    // occlusion_culler_avx2.cpp, rows y0..y1 (exclusive) of one triangle, width a multiple of 8
+    void RasterizeOccluderRows(const OccluderTriangle& triangle, float* depth, int width, int y0, int y1);
+    // true if any pixel in [x0, x1) x [y0, y1) is at or behind 'nearest'
+    bool DepthRectVisible(const float* depth, int width, int x0, int x1, int y0, int y1, float nearest);
+}
+#endif
+
+#endif
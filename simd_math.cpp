@@ -0,0 +1,264 @@
+#include "simd_math.h"
+#include "simd_kernels.h"
+
+#ifdef SIMD_X86
+#include <emmintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#elif defined(SIMD_NEON)
+#include <arm_neon.h>
+#endif
+
+namespace {
+#ifdef SIMD_X86
+	struct SseLanes {
+		struct V {
+			__m128 v;
+			friend V operator+(V a, V b) { return { _mm_add_ps(a.v, b.v) }; }
+			friend V operator-(V a, V b) { return { _mm_sub_ps(a.v, b.v) }; }
+			friend V operator*(V a, V b) { return { _mm_mul_ps(a.v, b.v) }; }
+			friend V operator/(V a, V b) { return { _mm_div_ps(a.v, b.v) }; }
+		};
+		static const std::size_t WIDTH = 4;
+
+		static V Set1(float s) { return { _mm_set1_ps(s) }; }
+		static V Neg(V a) { return { _mm_xor_ps(a.v, _mm_set1_ps(-0.0f)) }; }
+		static V Abs(V a) { return { _mm_andnot_ps(_mm_set1_ps(-0.0f), a.v) }; }
+		static V Max(V a, V b) { return { _mm_max_ps(a.v, b.v) }; }
+		static unsigned int LessEqual(V a, V b) { return (unsigned int)_mm_movemask_ps(_mm_cmple_ps(a.v, b.v)); }
+		static V Load(const float* p) { return { _mm_loadu_ps(p) }; }
+		static void Store(float* p, V a) { _mm_storeu_ps(p, a.v); }
+		static V Gather(const float* p, std::size_t stride) {
+			return { _mm_set_ps(p[3 * stride], p[2 * stride], p[stride], p[0]) };
+		}
+		static void Scatter(float* p, std::size_t stride, V a) {
+			alignas(16) float lanes[4];
+			_mm_store_ps(lanes, a.v);
+			for (int i = 0; i < 4; i++)
+				p[i * stride] = lanes[i];
+		}
+	};
+
+	inline void mulMat4Sse(const glm::mat4& a, const glm::mat4& b, glm::mat4& out) {
+		const float* pa = &a[0][0];
+		const float* pb = &b[0][0];
+		__m128 a0 = _mm_loadu_ps(pa);
+		__m128 a1 = _mm_loadu_ps(pa + 4);
+		__m128 a2 = _mm_loadu_ps(pa + 8);
+		__m128 a3 = _mm_loadu_ps(pa + 12);
+		// b may alias out, finish reading a column before writing it
+		for (int i = 0; i < 4; i++) {
+			__m128 r = _mm_mul_ps(a0, _mm_set1_ps(pb[i * 4 + 0]));
+			r = _mm_add_ps(r, _mm_mul_ps(a1, _mm_set1_ps(pb[i * 4 + 1])));
+			r = _mm_add_ps(r, _mm_mul_ps(a2, _mm_set1_ps(pb[i * 4 + 2])));
+			r = _mm_add_ps(r, _mm_mul_ps(a3, _mm_set1_ps(pb[i * 4 + 3])));
+			_mm_storeu_ps(&out[i][0], r);
+		}
+	}
+#elif defined(SIMD_NEON)
+	struct NeonLanes {
+		struct V {
+			float32x4_t v;
+			friend V operator+(V a, V b) { return { vaddq_f32(a.v, b.v) }; }
+			friend V operator-(V a, V b) { return { vsubq_f32(a.v, b.v) }; }
+			friend V operator*(V a, V b) { return { vmulq_f32(a.v, b.v) }; }
+			friend V operator/(V a, V b) { return { vdivq_f32(a.v, b.v) }; }
+		};
+		static const std::size_t WIDTH = 4;
+
+		static V Set1(float s) { return { vdupq_n_f32(s) }; }
+		static V Neg(V a) { return { vnegq_f32(a.v) }; }
+		static V Abs(V a) { return { vabsq_f32(a.v) }; }
+		static V Max(V a, V b) { return { vmaxq_f32(a.v, b.v) }; }
+		static unsigned int LessEqual(V a, V b) {
+			static const uint32_t weights[4] = { 1, 2, 4, 8 };
+			uint32x4_t bits = vandq_u32(vcleq_f32(a.v, b.v), vld1q_u32(weights));
+			uint32x2_t pairs = vorr_u32(vget_low_u32(bits), vget_high_u32(bits));
+			return vget_lane_u32(pairs, 0) | vget_lane_u32(pairs, 1);
+		}
+		static V Load(const float* p) { return { vld1q_f32(p) }; }
+		static void Store(float* p, V a) { vst1q_f32(p, a.v); }
+		static V Gather(const float* p, std::size_t stride) {
+			float lanes[4] = { p[0], p[stride], p[2 * stride], p[3 * stride] };
+			return { vld1q_f32(lanes) };
+		}
+		static void Scatter(float* p, std::size_t stride, V a) {
+			float lanes[4];
+			vst1q_f32(lanes, a.v);
+			for (int i = 0; i < 4; i++)
+				p[i * stride] = lanes[i];
+		}
+	};
+
+	inline void mulMat4Neon(const glm::mat4& a, const glm::mat4& b, glm::mat4& out) {
+		const float* pa = &a[0][0];
+		const float* pb = &b[0][0];
+		float32x4_t a0 = vld1q_f32(pa);
+		float32x4_t a1 = vld1q_f32(pa + 4);
+		float32x4_t a2 = vld1q_f32(pa + 8);
+		float32x4_t a3 = vld1q_f32(pa + 12);
+		// separate multiply and add, a fused vfma would round differently from glm
+		for (int i = 0; i < 4; i++) {
+			float32x4_t r = vmulq_n_f32(a0, pb[i * 4 + 0]);
+			r = vaddq_f32(r, vmulq_n_f32(a1, pb[i * 4 + 1]));
+			r = vaddq_f32(r, vmulq_n_f32(a2, pb[i * 4 + 2]));
+			r = vaddq_f32(r, vmulq_n_f32(a3, pb[i * 4 + 3]));
+			vst1q_f32(&out[i][0], r);
+		}
+	}
+#endif
+
+	SimdLevel detectSimdLevel() {
+#ifdef SIMD_X86
+#ifdef _MSC_VER
+		int info[4];
+		__cpuid(info, 1);
+		bool osSavesAvx = (info[2] & (1 << 27)) && (info[2] & (1 << 28)) && (_xgetbv(0) & 6) == 6;
+		if (osSavesAvx) {
+			__cpuidex(info, 7, 0);
+			if (info[1] & (1 << 5))
+				return SimdLevel::AVX2;
+		}
+#else
+		if (__builtin_cpu_supports("avx2"))
+			return SimdLevel::AVX2;
+#endif
+		return SimdLevel::SSE;
+#elif defined(SIMD_NEON)
+		return SimdLevel::NEON;
+#else
+		return SimdLevel::Scalar;
+#endif
+	}
+
+	SimdLevel& activeLevel() {
+		static SimdLevel level = detectSimdLevel();
+		return level;
+	}
+
+	void mulMat4Batch(const glm::mat4* a, std::size_t aStep, const glm::mat4* b, glm::mat4* out, std::size_t count) {
+#ifdef SIMD_X86
+		if (ActiveSimdLevel() == SimdLevel::AVX2) {
+			avx2::MulMat4(a, aStep, b, out, count);
+			return;
+		}
+#endif
+		for (std::size_t i = 0; i < count; i++)
+			out[i] = MulMat4(a[i * aStep], b[i]);
+	}
+}
+
+SimdLevel ActiveSimdLevel() {
+	return activeLevel();
+}
+
+bool ForceSimdLevel(SimdLevel level) {
+	SimdLevel detected = detectSimdLevel();
+	bool supported = level == SimdLevel::Scalar || level == detected
+		|| (level == SimdLevel::SSE && detected == SimdLevel::AVX2);
+	if (supported)
+		activeLevel() = level;
+	return supported;
+}
+
+glm::mat4 MulMat4(const glm::mat4& a, const glm::mat4& b) {
+#ifdef SIMD_X86
+	if (ActiveSimdLevel() != SimdLevel::Scalar) {
+		glm::mat4 result;
+		mulMat4Sse(a, b, result);
+		return result;
+	}
+#elif defined(SIMD_NEON)
+	if (ActiveSimdLevel() != SimdLevel::Scalar) {
+		glm::mat4 result;
+		mulMat4Neon(a, b, result);
+		return result;
+	}
+#endif
+	return a * b;
+}
+
+void MulMat4(std::span<const glm::mat4> a, std::span<const glm::mat4> b, std::span<glm::mat4> out) {
+	mulMat4Batch(a.data(), 1, b.data(), out.data(), b.size());
+}
+
+void MulMat4(const glm::mat4& a, std::span<const glm::mat4> b, std::span<glm::mat4> out) {
+	mulMat4Batch(&a, 0, b.data(), out.data(), b.size());
+}
+
+void NormalMatrices(std::span<const glm::mat4> models, std::span<glm::mat3> out) {
+	std::size_t count = models.size();
+	std::size_t done = 0;
+#ifdef SIMD_X86
+	if (ActiveSimdLevel() == SimdLevel::AVX2)
+		done = avx2::NormalMatrices(models.data(), out.data(), count);
+	else if (ActiveSimdLevel() == SimdLevel::SSE)
+		done = NormalMatricesKernel<SseLanes>(models.data(), out.data(), 0, count);
+#elif defined(SIMD_NEON)
+	if (ActiveSimdLevel() == SimdLevel::NEON)
+		done = NormalMatricesKernel<NeonLanes>(models.data(), out.data(), 0, count);
+#endif
+	NormalMatricesKernel<ScalarLanes>(models.data(), out.data(), done, count);
+}
+
+void AABBArray::Resize(std::size_t count) {
+	minX.resize(count);
+	minY.resize(count);
+	minZ.resize(count);
+	maxX.resize(count);
+	maxY.resize(count);
+	maxZ.resize(count);
+}
+
+void AABBArray::Set(std::size_t i, const glm::vec3& min, const glm::vec3& max) {
+	minX[i] = min.x;
+	minY[i] = min.y;
+	minZ[i] = min.z;
+	maxX[i] = max.x;
+	maxY[i] = max.y;
+	maxZ[i] = max.z;
+}
+
+void TransformAABBs(const AABBArray& local, std::span<const glm::mat4> transforms, AABBArray& world) {
+	std::size_t count = local.Size();
+	world.Resize(count);
+	AABBPointers boxes = {
+		{ local.minX.data(), local.minY.data(), local.minZ.data() },
+		{ local.maxX.data(), local.maxY.data(), local.maxZ.data() },
+		{ world.minX.data(), world.minY.data(), world.minZ.data() },
+		{ world.maxX.data(), world.maxY.data(), world.maxZ.data() },
+	};
+
+	std::size_t done = 0;
+#ifdef SIMD_X86
+	if (ActiveSimdLevel() == SimdLevel::AVX2)
+		done = avx2::TransformAABBs(boxes, transforms.data(), count);
+	else if (ActiveSimdLevel() == SimdLevel::SSE)
+		done = TransformAABBsKernel<SseLanes>(boxes, transforms.data(), 0, count);
+#elif defined(SIMD_NEON)
+	if (ActiveSimdLevel() == SimdLevel::NEON)
+		done = TransformAABBsKernel<NeonLanes>(boxes, transforms.data(), 0, count);
+#endif
+	TransformAABBsKernel<ScalarLanes>(boxes, transforms.data(), done, count);
+}
+
+void SphereOverlapsAABBs(const AABBArray& boxes, std::size_t first, const glm::vec3& center, float radius, std::span<uint8_t> hits) {
+	AABBPointers pointers = {
+		{ boxes.minX.data() + first, boxes.minY.data() + first, boxes.minZ.data() + first },
+		{ boxes.maxX.data() + first, boxes.maxY.data() + first, boxes.maxZ.data() + first },
+	};
+	std::size_t count = hits.size();
+
+	std::size_t done = 0;
+#ifdef SIMD_X86
+	if (ActiveSimdLevel() == SimdLevel::AVX2)
+		done = avx2::SphereOverlapsAABBs(pointers, center, radius, hits.data(), 0, count);
+	else if (ActiveSimdLevel() == SimdLevel::SSE)
+		done = SphereOverlapsAABBsKernel<SseLanes>(pointers, center, radius, hits.data(), 0, count);
+#elif defined(SIMD_NEON)
+	if (ActiveSimdLevel() == SimdLevel::NEON)
+		done = SphereOverlapsAABBsKernel<NeonLanes>(pointers, center, radius, hits.data(), 0, count);
+#endif
+	SphereOverlapsAABBsKernel<ScalarLanes>(pointers, center, radius, hits.data(), done, count);
+}
@@ -0,0 +1,53 @@
+#ifndef SIMD_MATH_H
+#define SIMD_MATH_H
+
+#include <glm/glm.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+// batch transform math with SSE, AVX2 and NEON paths picked at runtime.
+// every path follows glm's operation order, so results match the scalar glm code bit for bit.
+
+enum class SimdLevel {
+    Scalar,
+    SSE,
+    AVX2,
+    NEON,
+};
+
+// detected once from the CPU's features
+SimdLevel ActiveSimdLevel();
+// runs everything at the given level instead, if the CPU has it. returns false and changes
+// nothing otherwise. for tests comparing the paths, not to be called while work is in flight
+bool ForceSimdLevel(SimdLevel level);
+
+glm::mat4 MulMat4(const glm::mat4& a, const glm::mat4& b);
+// out[i] = a[i] * b[i]
+void MulMat4(std::span<const glm::mat4> a, std::span<const glm::mat4> b, std::span<glm::mat4> out);
+// out[i] = a * b[i], e.g. one parent or view-projection for many models
+void MulMat4(const glm::mat4& a, std::span<const glm::mat4> b, std::span<glm::mat4> out);
+
+// inverse transpose of each model's upper 3x3, for transforming normals
+void NormalMatrices(std::span<const glm::mat4> models, std::span<glm::mat3> out);
+
+// axis-aligned boxes as structure of arrays, one array per component
+struct AABBArray {
+    std::vector<float> minX, minY, minZ;
+    std::vector<float> maxX, maxY, maxZ;
+
+    std::size_t Size() const { return minX.size(); }
+    void Resize(std::size_t count);
+    void Set(std::size_t i, const glm::vec3& min, const glm::vec3& max);
+    glm::vec3 Min(std::size_t i) const { return glm::vec3(minX[i], minY[i], minZ[i]); }
+    glm::vec3 Max(std::size_t i) const { return glm::vec3(maxX[i], maxY[i], maxZ[i]); }
+};
+
+// world[i] = box enclosing local[i] transformed by transforms[i]
+void TransformAABBs(const AABBArray& local, std::span<const glm::mat4> transforms, AABBArray& world);
+// hits[i] = 1 where the sphere touches box first + i, else 0
+void SphereOverlapsAABBs(const AABBArray& boxes, std::size_t first, const glm::vec3& center, float radius, std::span<uint8_t> hits);
+
+#endif
@@ -0,0 +1,94 @@
+// compiled with AVX2 enabled (/arch:AVX2, -mavx2), nothing in here may run before the CPU check
+#include "simd_kernels.h"
+
+#ifdef SIMD_X86
+#include <immintrin.h>
+
+#include <cstring>
+
+namespace {
+	struct Avx2Lanes {
+		struct V {
+			__m256 v;
+			friend V operator+(V a, V b) { return { _mm256_add_ps(a.v, b.v) }; }
+			friend V operator-(V a, V b) { return { _mm256_sub_ps(a.v, b.v) }; }
+			friend V operator*(V a, V b) { return { _mm256_mul_ps(a.v, b.v) }; }
+			friend V operator/(V a, V b) { return { _mm256_div_ps(a.v, b.v) }; }
+		};
+		static const std::size_t WIDTH = 8;
+
+		static V Set1(float s) { return { _mm256_set1_ps(s) }; }
+		static V Neg(V a) { return { _mm256_xor_ps(a.v, _mm256_set1_ps(-0.0f)) }; }
+		static V Abs(V a) { return { _mm256_andnot_ps(_mm256_set1_ps(-0.0f), a.v) }; }
+		static V Max(V a, V b) { return { _mm256_max_ps(a.v, b.v) }; }
+		static unsigned int LessEqual(V a, V b) { return (unsigned int)_mm256_movemask_ps(_mm256_cmp_ps(a.v, b.v, _CMP_LE_OQ)); }
+		static V Load(const float* p) { return { _mm256_loadu_ps(p) }; }
+		static void Store(float* p, V a) { _mm256_storeu_ps(p, a.v); }
+		static V Gather(const float* p, std::size_t stride) {
+			__m256i lanes = _mm256_mullo_epi32(_mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7), _mm256_set1_epi32((int)stride));
+			return { _mm256_i32gather_ps(p, lanes, 4) };
+		}
+		static void Scatter(float* p, std::size_t stride, V a) {
+			alignas(32) float lanes[8];
+			_mm256_store_ps(lanes, a.v);
+			for (int i = 0; i < 8; i++)
+				p[i * stride] = lanes[i];
+		}
+	};
+
+	inline __m256 loadPair(const float* lo, const float* hi) {
+		return _mm256_insertf128_ps(_mm256_castps128_ps256(_mm_loadu_ps(lo)), _mm_loadu_ps(hi), 1);
+	}
+}
+
+namespace avx2 {
+	// two products per iteration, one in each 128-bit half
+	void MulMat4(const glm::mat4* a, std::size_t aStep, const glm::mat4* b, glm::mat4* out, std::size_t count) {
+		std::size_t i = 0;
+		for (; i + 2 <= count; i += 2) {
+			const float* pa0 = reinterpret_cast<const float*>(a + i * aStep);
+			const float* pa1 = reinterpret_cast<const float*>(a + (i + 1) * aStep);
+			const float* pb0 = reinterpret_cast<const float*>(b + i);
+			const float* pb1 = reinterpret_cast<const float*>(b + i + 1);
+			__m256 a0 = loadPair(pa0, pa1);
+			__m256 a1 = loadPair(pa0 + 4, pa1 + 4);
+			__m256 a2 = loadPair(pa0 + 8, pa1 + 8);
+			__m256 a3 = loadPair(pa0 + 12, pa1 + 12);
+
+			__m256 columns[4];
+			for (int c = 0; c < 4; c++) {
+				__m256 column = loadPair(pb0 + c * 4, pb1 + c * 4);
+				__m256 r = _mm256_mul_ps(a0, _mm256_permute_ps(column, 0x00));
+				r = _mm256_add_ps(r, _mm256_mul_ps(a1, _mm256_permute_ps(column, 0x55)));
+				r = _mm256_add_ps(r, _mm256_mul_ps(a2, _mm256_permute_ps(column, 0xAA)));
+				r = _mm256_add_ps(r, _mm256_mul_ps(a3, _mm256_permute_ps(column, 0xFF)));
+				columns[c] = r;
+			}
+			// written after all reads, b may alias out
+			float* po0 = reinterpret_cast<float*>(out + i);
+			float* po1 = reinterpret_cast<float*>(out + i + 1);
+			for (int c = 0; c < 4; c++) {
+				_mm_storeu_ps(po0 + c * 4, _mm256_castps256_ps128(columns[c]));
+				_mm_storeu_ps(po1 + c * 4, _mm256_extractf128_ps(columns[c], 1));
+			}
+		}
+		if (i < count) {
+			glm::mat4 product = ::MulMat4(a[i * aStep], b[i]);
+			std::memcpy(out + i, &product, sizeof(product));
+		}
+	}
+
+	std::size_t NormalMatrices(const glm::mat4* models, glm::mat3* out, std::size_t count) {
+		return NormalMatricesKernel<Avx2Lanes>(models, out, 0, count);
+	}
+
+	std::size_t TransformAABBs(const AABBPointers& boxes, const glm::mat4* transforms, std::size_t count) {
+		return TransformAABBsKernel<Avx2Lanes>(boxes, transforms, 0, count);
+	}
+
+	std::size_t SphereOverlapsAABBs(const AABBPointers& boxes, const glm::vec3& center, float radius,
+		uint8_t* hits, std::size_t begin, std::size_t end) {
+		return SphereOverlapsAABBsKernel<Avx2Lanes>(boxes, center, radius, hits, begin, end);
+	}
+}
+#endif
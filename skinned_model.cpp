@@ -0,0 +1,174 @@
+#include "skinned_model.h"
+#include "model.h"
+
+#include <cstddef>
+#include <iostream>
+
+using std::string;
+using std::vector;
+
+// texture unit the bone palette is bound to, above the material textures
+const int PALETTE_TEXTURE_UNIT = 15;
+
+SkinnedModel::SkinnedModel(const char* path, bool cpuSkinning) : cpuSkinning(cpuSkinning), paletteCapacity(0) {
+	glGenBuffers(1, &paletteBuffer);
+	glGenTextures(1, &paletteTexture);
+	loadModel(path);
+}
+
+SkinnedModel::~SkinnedModel() {
+	for (const auto& mesh : meshes) {
+		Heap().Free(mesh.range);
+		Mesh::Heap().Free(mesh.cpuRange);
+	}
+	glDeleteTextures(1, &paletteTexture);
+	glDeleteBuffers(1, &paletteBuffer);
+}
+
+GeometryHeap& SkinnedModel::Heap() {
+	static GeometryHeap heap({ sizeof(SkinnedVertex), {
+		{ 0, 3, GL_FLOAT, offsetof(SkinnedVertex, Position) },
+		{ 1, 3, GL_FLOAT, offsetof(SkinnedVertex, Normal) },
+		{ 2, 2, GL_FLOAT, offsetof(SkinnedVertex, TexCoords) },
+		{ 3, 3, GL_FLOAT, offsetof(SkinnedVertex, Tangent) },
+		{ 11, 4, GL_INT, offsetof(SkinnedVertex, BoneIDs), true },
+		{ 12, 4, GL_FLOAT, offsetof(SkinnedVertex, Weights) },
+	} }, 1 << 15, 1 << 17, Mesh::Instances().GetBuffer(), InstanceBuffer::Format());
+	return heap;
+}
+
+void SkinnedModel::loadModel(string path) {
+	Assimp::Importer import;
+	const aiScene* scene = import.ReadFile(path, aiProcess_Triangulate | aiProcess_CalcTangentSpace | aiProcess_LimitBoneWeights);
+
+	if (!scene || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE || !scene->mRootNode) {
+		std::cout << "ERROR::ASSIMP::" << import.GetErrorString() << std::endl;
+		return;
+	}
+	directory = path.substr(0, path.find_last_of('/'));
+
+	skeleton = Skeleton::FromScene(scene);
+	for (unsigned int i = 0; i < scene->mNumAnimations; i++) {
+		clips.push_back(AnimationClip::FromAssimp(scene->mAnimations[i], skeleton));
+	}
+
+	processNode(scene->mRootNode, scene);
+}
+
+void SkinnedModel::processNode(aiNode* node, const aiScene* scene) {
+	for (unsigned int i = 0; i < node->mNumMeshes; i++) {
+		meshes.push_back(processMesh(scene->mMeshes[node->mMeshes[i]], scene));
+	}
+	for (unsigned int i = 0; i < node->mNumChildren; i++) {
+		processNode(node->mChildren[i], scene);
+	}
+}
+
+SkinnedModel::SkinnedMesh SkinnedModel::processMesh(aiMesh* mesh, const aiScene* scene) {
+	std::pmr::vector<Vertex> vertices;
+	std::pmr::vector<unsigned int> indices;
+	ReadMeshGeometry(mesh, vertices, indices);
+
+	vector<SkinnedVertex> skinnedVertices(vertices.size());
+	for (std::size_t i = 0; i < vertices.size(); i++) {
+		SkinnedVertex& v = skinnedVertices[i];
+		v.Position = vertices[i].Position;
+		v.Normal = vertices[i].Normal;
+		v.TexCoords = vertices[i].TexCoords;
+		v.Tangent = vertices[i].Tangent;
+		for (int b = 0; b < MAX_BONE_INFLUENCE; b++) {
+			v.BoneIDs[b] = 0;
+			v.Weights[b] = 0.0f;
+		}
+	}
+
+	// keep the four strongest influences per vertex
+	for (unsigned int i = 0; i < mesh->mNumBones; i++) {
+		const aiBone* bone = mesh->mBones[i];
+		int joint = skeleton.Find(bone->mName.C_Str());
+		if (joint < 0)
+			continue;
+
+		for (unsigned int j = 0; j < bone->mNumWeights; j++) {
+			SkinnedVertex& v = skinnedVertices[bone->mWeights[j].mVertexId];
+			float weight = bone->mWeights[j].mWeight;
+			int weakest = 0;
+			for (int b = 1; b < MAX_BONE_INFLUENCE; b++) {
+				if (v.Weights[b] < v.Weights[weakest])
+					weakest = b;
+			}
+			if (weight > v.Weights[weakest]) {
+				v.BoneIDs[weakest] = joint;
+				v.Weights[weakest] = weight;
+			}
+		}
+	}
+	for (auto& v : skinnedVertices) {
+		float sum = v.Weights[0] + v.Weights[1] + v.Weights[2] + v.Weights[3];
+		if (sum > 0.0f) {
+			for (int b = 0; b < MAX_BONE_INFLUENCE; b++) {
+				v.Weights[b] /= sum;
+			}
+		} else {
+			// unskinned vertices follow the root
+			v.Weights[0] = 1.0f;
+		}
+	}
+
+	SkinnedMesh result;
+	result.range = Heap().Allocate(skinnedVertices.data(), (unsigned int)skinnedVertices.size(), indices.data(), (unsigned int)indices.size());
+	result.textures = LoadMeshTextures(mesh, scene, directory, texturesLoaded);
+	if (cpuSkinning) {
+		result.cpuRange = Mesh::Heap().Allocate(vertices.data(), (unsigned int)vertices.size(), indices.data(), (unsigned int)indices.size());
+		result.bindVertices = std::move(skinnedVertices);
+	}
+	return result;
+}
+
+void SkinnedModel::DrawInstanced(Shader& shader, std::span<const glm::mat4> models, std::span<const glm::mat4> palettes) {
+	if (models.empty())
+		return;
+
+	// orphan and refill the palette buffer, the shader indexes it with gl_InstanceID
+	std::size_t bytes = palettes.size_bytes();
+	glBindBuffer(GL_TEXTURE_BUFFER, paletteBuffer);
+	if (bytes > paletteCapacity) {
+		paletteCapacity = bytes;
+		glBufferData(GL_TEXTURE_BUFFER, bytes, palettes.data(), GL_STREAM_DRAW);
+		glBindTexture(GL_TEXTURE_BUFFER, paletteTexture);
+		glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32F, paletteBuffer);
+	} else {
+		glBufferData(GL_TEXTURE_BUFFER, paletteCapacity, NULL, GL_STREAM_DRAW);
+		glBufferSubData(GL_TEXTURE_BUFFER, 0, bytes, palettes.data());
+	}
+	glBindBuffer(GL_TEXTURE_BUFFER, 0);
+
+	glActiveTexture(GL_TEXTURE0 + PALETTE_TEXTURE_UNIT);
+	glBindTexture(GL_TEXTURE_BUFFER, paletteTexture);
+	glActiveTexture(GL_TEXTURE0);
+	shader.setInt("bonePalette", PALETTE_TEXTURE_UNIT);
+	shader.setInt("boneCount", (int)skeleton.JointCount());
+
+	GLuint baseInstance = Mesh::Instances().Upload(models);
+	for (const auto& mesh : meshes) {
+		BindMeshTextures(shader, mesh.textures);
+		Heap().DrawInstanced(mesh.range, (GLsizei)models.size(), baseInstance);
+	}
+}
+
+void SkinnedModel::DrawCPUSkinned(Shader& shader, std::span<const glm::mat4> palette, const glm::mat4& transform) {
+	if (!cpuSkinning) {
+		std::cout << "ERROR::SKINNED_MODEL::LOADED_WITHOUT_CPU_SKINNING" << std::endl;
+		return;
+	}
+
+	GLuint baseInstance = Mesh::Instances().Upload(std::span<const glm::mat4>(&transform, 1));
+	for (const auto& mesh : meshes) {
+		skinned.resize(mesh.bindVertices.size());
+		SkinVertices(mesh.bindVertices, palette, skinned);
+		Mesh::Heap().UpdateVertices(mesh.cpuRange, skinned.data());
+
+		BindMeshTextures(shader, mesh.textures);
+		Mesh::Heap().DrawInstanced(mesh.cpuRange, 1, baseInstance);
+	}
+}
@@ -0,0 +1,64 @@
+#ifndef SKINNED_MODEL_H
+#define SKINNED_MODEL_H
+
+#include <assimp/Importer.hpp>
+#include <assimp/scene.h>
+#include <assimp/postprocess.h>
+
+#include "shader.h"
+#include "mesh.h"
+#include "animation.h"
+
+#include <span>
+#include <string>
+#include <vector>
+
+// model with a skeleton and animation clips.
+// GPU path: shaders/skinned.vs blends bones from a palette texture buffer, one palette per instance.
+// CPU path: SkinVertices deforms a standard-layout copy so any regular shader can draw it.
+class SkinnedModel {
+public:
+    // cpuSkinning keeps the bind-pose vertices on the host, which the CPU path needs
+    SkinnedModel(const char* path, bool cpuSkinning = false);
+    // returns the geometry to the heaps and deletes the palette buffer
+    ~SkinnedModel();
+    SkinnedModel(const SkinnedModel&) = delete;
+    SkinnedModel& operator=(const SkinnedModel&) = delete;
+
+    const Skeleton& GetSkeleton() const { return skeleton; }
+    const std::vector<AnimationClip>& Clips() const { return clips; }
+
+    // palettes holds models.size() * JointCount() matrices, in instance order
+    void DrawInstanced(Shader& shader, std::span<const glm::mat4> models, std::span<const glm::mat4> palettes);
+    // skins every mesh with one palette on the CPU and draws it through Mesh::Heap(), placed by transform
+    void DrawCPUSkinned(Shader& shader, std::span<const glm::mat4> palette, const glm::mat4& transform = glm::mat4(1.0f));
+
+    // shared heap for the SkinnedVertex layout
+    static GeometryHeap& Heap();
+private:
+    struct SkinnedMesh {
+        GeometryRange range;
+        std::vector<Texture> textures;
+        // CPU path only
+        std::vector<SkinnedVertex> bindVertices;
+        GeometryRange cpuRange;
+    };
+
+    std::vector<SkinnedMesh> meshes;
+    Skeleton skeleton;
+    std::vector<AnimationClip> clips;
+    std::string directory;
+    std::vector<Texture> texturesLoaded;
+    bool cpuSkinning;
+
+    // bone palettes, RGBA32F texture buffer with four texels per matrix
+    unsigned int paletteBuffer, paletteTexture;
+    std::size_t paletteCapacity;
+    std::vector<Vertex> skinned;
+
+    void loadModel(std::string path);
+    void processNode(aiNode* node, const aiScene* scene);
+    SkinnedMesh processMesh(aiMesh* mesh, const aiScene* scene);
+};
+
+#endif
@@ -0,0 +1,238 @@
+#include "streaming_model.h"
+
+#include <chrono>
+#include <iostream>
+#include <limits>
+#include <set>
+
+using std::string;
+using std::vector;
+
+StreamingModel::StreamingModel(const char* path, std::function<void()> onComplete)
+	: onComplete(std::move(onComplete)), parsed(false), cancelled(false), complete(false) {
+	string pathStr(path);
+	directory = pathStr.substr(0, pathStr.find_last_of('/'));
+	worker = std::thread(&StreamingModel::load, this, pathStr);
+}
+
+StreamingModel::~StreamingModel() {
+	cancelled = true;
+	if (worker.joinable())
+		worker.join();
+
+	for (auto& item : queue) {
+		if (item.kind == StreamItem::Image)
+			FreeTextureImage(item.image);
+	}
+}
+
+std::size_t StreamingModel::StreamItem::Bytes() const {
+	switch (kind) {
+	case Image:
+		return (std::size_t)image.width * image.height * image.nrChannels;
+	case Geometry:
+		return vertices.size() * sizeof(Vertex) + indices.size() * sizeof(unsigned int);
+	default:
+		return 0;
+	}
+}
+
+void StreamingModel::push(StreamItem item) {
+	std::lock_guard<std::mutex> lock(queueMutex);
+	queue.push_back(std::move(item));
+}
+
+// worker thread: everything that does not need the GL context
+void StreamingModel::load(string path) {
+	Assimp::Importer import;
+	const aiScene* scene = import.ReadFile(path, aiProcess_Triangulate | aiProcess_CalcTangentSpace);
+
+	if (!scene || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE || !scene->mRootNode) {
+		std::cout << "ERROR::ASSIMP::" << import.GetErrorString() << std::endl;
+		parsed = true;
+		return;
+	}
+
+	// same pre-order walk as Model::processNode, with the world transform of every node.
+	// the transforms are baked into the geometry, like Model's static batching does
+	vector<std::pair<const aiNode*, glm::mat4>> nodes;
+	vector<std::pair<const aiNode*, glm::mat4>> stack = { { scene->mRootNode, glm::mat4(1.0f) } };
+	while (!stack.empty()) {
+		auto [node, parentTransform] = stack.back();
+		stack.pop_back();
+		glm::mat4 transform = parentTransform * AssimpToGlm(node->mTransformation);
+		nodes.emplace_back(node, transform);
+		for (unsigned int i = node->mNumChildren; i > 0; i--) {
+			stack.emplace_back(node->mChildren[i - 1], transform);
+		}
+	}
+
+	// bounds go first so the proxy shows up as soon as possible
+	StreamItem bounds;
+	bounds.kind = StreamItem::Bounds;
+	bounds.boundsMin = glm::vec3(std::numeric_limits<float>::max());
+	bounds.boundsMax = glm::vec3(-std::numeric_limits<float>::max());
+	bool hasGeometry = false;
+	for (const auto& [node, transform] : nodes) {
+		for (unsigned int i = 0; i < node->mNumMeshes; i++) {
+			const aiMesh* mesh = scene->mMeshes[node->mMeshes[i]];
+			for (unsigned int j = 0; j < mesh->mNumVertices; j++) {
+				glm::vec3 p(transform * glm::vec4(mesh->mVertices[j].x, mesh->mVertices[j].y, mesh->mVertices[j].z, 1.0f));
+				bounds.boundsMin = glm::min(bounds.boundsMin, p);
+				bounds.boundsMax = glm::max(bounds.boundsMax, p);
+				hasGeometry = true;
+			}
+		}
+	}
+	if (hasGeometry)
+		push(std::move(bounds));
+
+	const std::pair<aiTextureType, const char*> textureTypes[] = {
+		{ aiTextureType_DIFFUSE, "texture_diffuse" },
+		{ aiTextureType_SPECULAR, "texture_specular" },
+		{ aiTextureType_HEIGHT, "texture_normal" },
+	};
+	std::set<string> decoded;
+
+	for (const auto& [node, transform] : nodes) {
+		if (cancelled)
+			break;
+		for (unsigned int i = 0; i < node->mNumMeshes && !cancelled; i++) {
+			const aiMesh* mesh = scene->mMeshes[node->mMeshes[i]];
+
+			StreamItem item;
+			item.kind = StreamItem::Geometry;
+			item.vertices.reserve(mesh->mNumVertices);
+			item.indices.reserve((std::size_t)mesh->mNumFaces * 3);
+			ReadMeshGeometry(mesh, item.vertices, item.indices);
+			BakeTransform(item.vertices, transform);
+
+			// decode textures the mesh needs before it is queued, so they are uploaded first
+			const aiMaterial* material = scene->mMaterials[mesh->mMaterialIndex];
+			for (const auto& [type, typeName] : textureTypes) {
+				for (unsigned int j = 0; j < material->GetTextureCount(type); j++) {
+					aiString str;
+					material->GetTexture(type, j, &str);
+					item.textures.emplace_back(typeName, str.C_Str());
+
+					if (!decoded.insert(str.C_Str()).second)
+						continue;
+					StreamItem image;
+					image.kind = StreamItem::Image;
+					image.path = str.C_Str();
+					LoadTextureImage(str.C_Str(), directory, image.image);
+					push(std::move(image));
+				}
+			}
+			push(std::move(item));
+		}
+	}
+
+	parsed = true;
+}
+
+void StreamingModel::Update(const StreamingBudget& budget) {
+	if (complete)
+		return;
+
+	auto start = std::chrono::steady_clock::now();
+	std::size_t bytes = 0;
+	while (true) {
+		StreamItem item;
+		{
+			std::lock_guard<std::mutex> lock(queueMutex);
+			if (queue.empty())
+				break;
+			// the first item always goes through so a single large item cannot stall streaming
+			if (bytes > 0 && bytes + queue.front().Bytes() > budget.bytes)
+				break;
+			item = std::move(queue.front());
+			queue.pop_front();
+		}
+
+		bytes += item.Bytes();
+		upload(item);
+
+		std::chrono::duration<float, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+		if (elapsed.count() >= budget.milliseconds)
+			break;
+	}
+
+	// read the flag before the queue: once it is set the worker has pushed everything
+	bool done = parsed;
+	std::lock_guard<std::mutex> lock(queueMutex);
+	if (done && queue.empty()) {
+		complete = true;
+		proxy.clear();
+		if (onComplete)
+			onComplete();
+	}
+}
+
+void StreamingModel::upload(StreamItem& item) {
+	switch (item.kind) {
+	case StreamItem::Bounds:
+		buildProxy(item.boundsMin, item.boundsMax);
+		break;
+	case StreamItem::Image:
+		textureIds[item.path] = TextureFromImage(item.image);
+		FreeTextureImage(item.image);
+		break;
+	case StreamItem::Geometry: {
+		vector<Texture> textures;
+		for (const auto& [type, path] : item.textures) {
+			textures.push_back({ textureIds[path], type, path });
+		}
+		meshes.emplace_back(item.vertices, item.indices, std::move(textures));
+		break;
+	}
+	}
+}
+
+void StreamingModel::buildProxy(const glm::vec3& boundsMin, const glm::vec3& boundsMax) {
+	const glm::vec3 normals[6] = {
+		glm::vec3(1.0f, 0.0f, 0.0f), glm::vec3(-1.0f, 0.0f, 0.0f),
+		glm::vec3(0.0f, 1.0f, 0.0f), glm::vec3(0.0f, -1.0f, 0.0f),
+		glm::vec3(0.0f, 0.0f, 1.0f), glm::vec3(0.0f, 0.0f, -1.0f),
+	};
+	const glm::vec2 corners[4] = { glm::vec2(-1.0f, -1.0f), glm::vec2(1.0f, -1.0f), glm::vec2(1.0f, 1.0f), glm::vec2(-1.0f, 1.0f) };
+
+	glm::vec3 center = (boundsMin + boundsMax) * 0.5f;
+	glm::vec3 extent = (boundsMax - boundsMin) * 0.5f;
+
+	vector<Vertex> vertices;
+	vector<unsigned int> indices;
+	for (const auto& n : normals) {
+		glm::vec3 u = n.x != 0.0f ? glm::vec3(0.0f, 1.0f, 0.0f) : glm::vec3(1.0f, 0.0f, 0.0f);
+		glm::vec3 v = glm::cross(n, u);
+
+		unsigned int base = (unsigned int)vertices.size();
+		for (const auto& c : corners) {
+			Vertex vertex;
+			vertex.Position = center + extent * (n + u * c.x + v * c.y);
+			vertex.Normal = n;
+			vertex.TexCoords = (c + glm::vec2(1.0f)) * 0.5f;
+			vertex.Tangent = u;
+			vertices.push_back(vertex);
+		}
+		for (unsigned int index : { 0u, 1u, 2u, 0u, 2u, 3u }) {
+			indices.push_back(base + index);
+		}
+	}
+	proxy.emplace_back(vertices, indices, vector<Texture>());
+}
+
+void StreamingModel::Draw(Shader& shader, const glm::mat4& transform) {
+	DrawInstanced(shader, std::span<const glm::mat4>(&transform, 1));
+}
+
+void StreamingModel::DrawInstanced(Shader& shader, std::span<const glm::mat4> models) {
+	if (models.empty())
+		return;
+
+	GLuint baseInstance = Mesh::Instances().Upload(models);
+	for (auto& mesh : drawable()) {
+		mesh.BindTextures(shader);
+		Mesh::Heap().DrawInstanced(mesh.Range(), (GLsizei)models.size(), baseInstance);
+	}
+}
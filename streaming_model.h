@@ -0,0 +1,88 @@
+#ifndef STREAMING_MODEL_H
+#define STREAMING_MODEL_H
+
+#include <assimp/Importer.hpp>
+#include <assimp/scene.h>
+#include <assimp/postprocess.h>
+
+#include "shader.h"
+#include "mesh.h"
+#include "model.h"
+
+#include <atomic>
+#include <deque>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <span>
+#include <string>
+#include <thread>
+#include <vector>
+
+// per-frame limits for StreamingModel::Update
+struct StreamingBudget {
+    float milliseconds = 2.0f;
+    std::size_t bytes = 4 << 20;
+};
+
+// model handle that is drawable right away.
+// parsing, geometry extraction and image decoding run on a worker thread; the GL uploads are
+// spread over frames by Update() so a large asset never stalls a single frame.
+// until the first mesh is uploaded a bounding box proxy is drawn in its place.
+// node transforms are baked into the streamed geometry and the proxy bounds, so the model lands
+// where Model puts it.
+class StreamingModel {
+public:
+    StreamingModel(const char* path, std::function<void()> onComplete = nullptr);
+    ~StreamingModel();
+
+    StreamingModel(const StreamingModel&) = delete;
+    StreamingModel& operator=(const StreamingModel&) = delete;
+
+    // uploads queued textures and meshes until the budget is spent, call once per frame
+    void Update(const StreamingBudget& budget = {});
+
+    void Draw(Shader& shader, const glm::mat4& transform = glm::mat4(1.0f));
+    void DrawInstanced(Shader& shader, std::span<const glm::mat4> models);
+
+    bool IsComplete() const { return complete; }
+private:
+    struct StreamItem {
+        enum Kind { Bounds, Image, Geometry } kind;
+        // Bounds
+        glm::vec3 boundsMin, boundsMax;
+        // Image
+        std::string path;
+        TextureImage image;
+        // Geometry
+        std::pmr::vector<Vertex> vertices;
+        std::pmr::vector<unsigned int> indices;
+        std::vector<std::pair<std::string, std::string>> textures; // (type, path)
+
+        std::size_t Bytes() const;
+    };
+
+    std::string directory;
+    std::function<void()> onComplete;
+
+    // shared with the worker
+    std::thread worker;
+    std::mutex queueMutex;
+    std::deque<StreamItem> queue;
+    std::atomic<bool> parsed;
+    std::atomic<bool> cancelled;
+
+    // GL thread only
+    std::vector<Mesh> meshes;
+    std::vector<Mesh> proxy;
+    std::map<std::string, unsigned int> textureIds;
+    bool complete;
+
+    void load(std::string path);
+    void push(StreamItem item);
+    void upload(StreamItem& item);
+    void buildProxy(const glm::vec3& boundsMin, const glm::vec3& boundsMax);
+    std::vector<Mesh>& drawable() { return meshes.empty() ? proxy : meshes; }
+};
+
+#endif
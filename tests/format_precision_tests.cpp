@@ -0,0 +1,118 @@
+#include "tests.h"
+
+#include "format_precision.h"
+
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+
+namespace {
+	// positive float with a 5-bit exponent biased by 15 and the given mantissa width, like each
+	// channel of GL_R11F_G11F_B10F. GL lets the conversion round or truncate, both are covered
+	uint32_t encodeUnsignedFloat(float value, int mantissaBits, bool roundToNearest) {
+		uint32_t bits;
+		std::memcpy(&bits, &value, sizeof(bits));
+		uint32_t exponent = ((bits >> 23) & 0xff) - 127 + 15;
+		uint32_t mantissa = bits & 0x7fffff;
+		int dropped = 23 - mantissaBits;
+
+		uint32_t stored = mantissa >> dropped;
+		if (roundToNearest && ((mantissa >> (dropped - 1)) & 1)) {
+			stored++;
+			// carried into the exponent
+			if (stored >> mantissaBits) {
+				stored = 0;
+				exponent++;
+			}
+		}
+		return (exponent << mantissaBits) | stored;
+	}
+
+	float decodeUnsignedFloat(uint32_t bits, int mantissaBits) {
+		int exponent = (int)(bits >> mantissaBits);
+		uint32_t mantissa = bits & ((1u << mantissaBits) - 1);
+		return std::ldexp(1.0f + (float)mantissa / (float)(1u << mantissaBits), exponent - 15);
+	}
+
+	int exponentOf(uint32_t bits, int mantissaBits) {
+		return (int)(bits >> mantissaBits);
+	}
+}
+
+TEST(R11G11B10ProbeRoundTrip) {
+	const float* reference = FORMAT_PROBE_VALUES;
+	float precision = RelativePrecision(GL_R11F_G11F_B10F);
+	CHECK(precision == 1.0f / 32.0f);
+
+	// each probe value through each channel, red and green keep 6 mantissa bits, blue 5
+	const int mantissaBits[3] = { 6, 6, 5 };
+	const int shifts[3] = { 0, 11, 22 };
+	for (bool roundToNearest : { false, true }) {
+		for (int value = 0; value < 3; value++) {
+			uint32_t packed = 0;
+			for (int c = 0; c < 3; c++)
+				packed |= encodeUnsignedFloat(reference[(value + c) % 3], mantissaBits[c], roundToNearest) << shifts[c];
+
+			for (int c = 0; c < 3; c++) {
+				uint32_t bits = (packed >> shifts[c]) & ((1u << (mantissaBits[c] + 5)) - 1);
+				float expected = reference[(value + c) % 3];
+				float stored = decodeUnsignedFloat(bits, mantissaBits[c]);
+
+				// a normal number, not flushed to zero or overflowing to infinity
+				CHECK(exponentOf(bits, mantissaBits[c]) >= 1 && exponentOf(bits, mantissaBits[c]) <= 30);
+				CHECK(std::abs(stored - expected) <= expected * precision);
+			}
+		}
+
+		// the probe itself: cleared to the reference, read back as RGBA with alpha 1
+		float pixel[4] = { 0.0f, 0.0f, 0.0f, 1.0f };
+		for (int c = 0; c < 3; c++)
+			pixel[c] = decodeUnsignedFloat(encodeUnsignedFloat(reference[c], mantissaBits[c], roundToNearest), mantissaBits[c]);
+		CHECK(ProbeReadbackMatches(GL_R11F_G11F_B10F, pixel, 3));
+	}
+
+	// a mantissa the format cannot hold, so the bound is actually exercised: 1 + 1/64 + 1/128
+	float between = 1.0f + 1.0f / 64.0f + 1.0f / 128.0f;
+	float blue = decodeUnsignedFloat(encodeUnsignedFloat(between, 5, false), 5);
+	CHECK(blue != between);
+	CHECK(std::abs(blue - between) <= between * precision);
+}
+
+TEST(ProbeReadbackRejectsOutOfBound) {
+	const int mantissaBits[3] = { 6, 6, 5 };
+	float packed[4] = { 0.0f, 0.0f, 0.0f, 1.0f };
+	for (int c = 0; c < 3; c++)
+		packed[c] = decodeUnsignedFloat(encodeUnsignedFloat(FORMAT_PROBE_VALUES[c], mantissaBits[c], false), mantissaBits[c]);
+	CHECK(ProbeReadbackMatches(GL_R11F_G11F_B10F, packed, 3));
+
+	// red clamped to 1, what a target silently backed by a normalized format reads back
+	float clamped[4] = { 1.0f, packed[1], packed[2], packed[3] };
+	CHECK(!ProbeReadbackMatches(GL_R11F_G11F_B10F, clamped, 3));
+
+	// blue one step of a 4-bit mantissa off, just past the 5-bit bound
+	float coarse[4] = { packed[0], packed[1], packed[2] * (1.0f + 1.0f / 16.0f), packed[3] };
+	CHECK(std::abs(coarse[2] - FORMAT_PROBE_VALUES[2]) > FORMAT_PROBE_VALUES[2] * RelativePrecision(GL_R11F_G11F_B10F));
+	CHECK(!ProbeReadbackMatches(GL_R11F_G11F_B10F, coarse, 3));
+
+	// blue flushed to zero
+	float flushed[4] = { packed[0], packed[1], 0.0f, packed[3] };
+	CHECK(!ProbeReadbackMatches(GL_R11F_G11F_B10F, flushed, 3));
+
+	// only the format's channels are compared, whatever alpha reads back as
+	float noAlpha[4] = { packed[0], packed[1], packed[2], 0.0f };
+	CHECK(ProbeReadbackMatches(GL_R11F_G11F_B10F, noAlpha, 3));
+	CHECK(!ProbeReadbackMatches(GL_R11F_G11F_B10F, noAlpha, 4));
+}
+
+TEST(HalfFloatProbeRoundTrip) {
+	float precision = RelativePrecision(GL_RGBA16F);
+	for (bool roundToNearest : { false, true }) {
+		// the sign bit is never set by the probe, the rest is laid out as above
+		for (int c = 0; c < 4; c++) {
+			float expected = FORMAT_PROBE_VALUES[c];
+			uint32_t bits = encodeUnsignedFloat(expected, 10, roundToNearest);
+			CHECK(exponentOf(bits, 10) >= 1 && exponentOf(bits, 10) <= 30);
+			CHECK(std::abs(decodeUnsignedFloat(bits, 10) - expected) <= expected * precision);
+		}
+	}
+}
@@ -0,0 +1,125 @@
+#include "tests.h"
+
+#include "blur_kernel.h"
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+
+namespace {
+	// one line of texels, addressed like a GL_CLAMP_TO_EDGE texture
+	struct Line {
+		std::vector<float> texels;
+
+		float Fetch(int x) const { return texels[std::clamp(x, 0, (int)texels.size() - 1)]; }
+		// linear filtering at texel coordinate x, texel i's centre sits at i
+		float Sample(float x) const {
+			float base = std::floor(x);
+			float t = x - base;
+			return Fetch((int)base) * (1.0f - t) + Fetch((int)base + 1) * t;
+		}
+	};
+
+	// the same gaussian in double, summed over the full [-radius, radius]
+	std::vector<double> referenceBlur(const Line& line, double sigma) {
+		int radius = (int)std::ceil(3.0 * sigma);
+		std::vector<double> weights;
+		double total = 0.0;
+		for (int i = -radius; i <= radius; i++) {
+			weights.push_back(std::exp(-(double)(i * i) / (2.0 * sigma * sigma)));
+			total += weights.back();
+		}
+
+		std::vector<double> result(line.texels.size());
+		for (int x = 0; x < (int)result.size(); x++) {
+			double sum = 0.0;
+			for (int i = -radius; i <= radius; i++)
+				sum += weights[i + radius] / total * line.Fetch(x + i);
+			result[x] = sum;
+		}
+		return result;
+	}
+
+	// what gaussian_blur.fs computes for one texel with bilinear fetches, and the compute path
+	// with the point samples
+	float applyKernel(const Line& line, const BlurKernel& kernel, int x, bool filtered) {
+		float result = line.Fetch(x) * kernel.weights[0];
+		for (std::size_t i = 1; i < kernel.weights.size(); i++) {
+			float offset = kernel.offsets[i];
+			if (filtered) {
+				result += line.Sample(x + offset) * kernel.weights[i];
+				result += line.Sample(x - offset) * kernel.weights[i];
+			} else {
+				result += line.Fetch(x + (int)offset) * kernel.weights[i];
+				result += line.Fetch(x - (int)offset) * kernel.weights[i];
+			}
+		}
+		return result;
+	}
+
+	float halfKernelSum(const BlurKernel& kernel) {
+		float total = kernel.weights[0];
+		for (std::size_t i = 1; i < kernel.weights.size(); i++)
+			total += 2.0f * kernel.weights[i];
+		return total;
+	}
+}
+
+TEST(BlurKernelMatchesReferenceConvolution) {
+	std::mt19937 rng(6);
+	std::uniform_real_distribution<float> value(0.0f, 1.0f);
+	Line line;
+	for (int i = 0; i < 160; i++)
+		line.texels.push_back(value(rng));
+	// a hard edge and an isolated spike, where a wrong offset shows most
+	std::fill(line.texels.begin() + 60, line.texels.begin() + 100, 1.0f);
+	line.texels[130] = 40.0f;
+
+	for (int sigma = 1; sigma <= 10; sigma++) {
+		BlurKernel discrete = BlurKernel::Gaussian((float)sigma);
+		BlurKernel folded = BlurKernel::FoldBilinear(discrete);
+		std::cout << "  sigma " << sigma << ": " << discrete.weights.size() << " taps, " << folded.weights.size() << " folded" << std::endl;
+
+		CHECK((int)discrete.weights.size() == (int)std::ceil(3.0f * sigma) + 1);
+		CHECK(folded.weights.size() == discrete.weights.size() / 2 + 1);
+		CHECK(std::fabs(halfKernelSum(discrete) - 1.0f) < 1e-5f);
+		CHECK(std::fabs(halfKernelSum(folded) - 1.0f) < 1e-5f);
+		for (std::size_t i = 1; i < folded.offsets.size(); i++)
+			CHECK(folded.offsets[i] > folded.offsets[i - 1]);
+
+		std::vector<double> reference = referenceBlur(line, sigma);
+		double discreteError = 0.0, foldedError = 0.0;
+		for (int x = 0; x < (int)line.texels.size(); x++) {
+			discreteError = std::max(discreteError, std::fabs(applyKernel(line, discrete, x, false) - reference[x]));
+			foldedError = std::max(foldedError, std::fabs(applyKernel(line, folded, x, true) - reference[x]));
+		}
+		// float rounding only, against texel values up to 40
+		CHECK(discreteError < 1e-4);
+		CHECK(foldedError < 1e-4);
+	}
+}
+
+TEST(BlurKernelWithoutSigmaIsIdentity) {
+	for (float sigma : { 0.0f, -1.0f }) {
+		BlurKernel discrete = BlurKernel::Gaussian(sigma);
+		CHECK(discrete.offsets.size() == 1 && discrete.offsets[0] == 0.0f);
+		CHECK(discrete.weights.size() == 1 && discrete.weights[0] == 1.0f);
+
+		BlurKernel folded = BlurKernel::FoldBilinear(discrete);
+		CHECK(folded.offsets.size() == 1 && folded.weights.size() == 1 && folded.weights[0] == 1.0f);
+	}
+}
+
+TEST(BlurKernelDropsUnderflowedTaps) {
+	// everything past about 7 texels is exactly 0 in float
+	BlurKernel discrete = BlurKernel::Gaussian(0.5f, 20);
+	CHECK(discrete.weights.back() == 0.0f);
+
+	BlurKernel folded = BlurKernel::FoldBilinear(discrete);
+	CHECK(folded.weights.size() < discrete.weights.size() / 2 + 1);
+	for (std::size_t i = 0; i < folded.weights.size(); i++) {
+		CHECK(std::isfinite(folded.offsets[i]));
+		CHECK(folded.weights[i] > 0.0f);
+	}
+	CHECK(std::fabs(halfKernelSum(folded) - 1.0f) < 1e-5f);
+}
@@ -0,0 +1,21 @@
+#include "tests.h"
+
+std::vector<TestCase>& Tests() {
+	static std::vector<TestCase> tests;
+	return tests;
+}
+
+int& Failures() {
+	static int failures = 0;
+	return failures;
+}
+
+int main() {
+	for (const TestCase& test : Tests()) {
+		int before = Failures();
+		test.run();
+		std::cout << (Failures() == before ? "ok     " : "FAILED ") << test.name << std::endl;
+	}
+	std::cout << Tests().size() << " tests, " << Failures() << " failed checks" << std::endl;
+	return Failures() == 0 ? 0 : 1;
+}
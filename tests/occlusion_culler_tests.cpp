@@ -0,0 +1,105 @@
+#include "tests.h"
+
+#include "occlusion_culler.h"
+#include "simd_math.h"
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <cstring>
+
+namespace {
+	const AABB unitCube = { glm::vec3(-0.5f), glm::vec3(0.5f) };
+
+	glm::mat4 viewProjection(const glm::vec3& eye, const glm::vec3& target) {
+		return glm::perspective(glm::radians(45.0f), 800.0f / 600.0f, 0.1f, 100.0f)
+			* glm::lookAt(eye, target, glm::vec3(0.0f, 1.0f, 0.0f));
+	}
+
+	glm::mat4 placed(const glm::vec3& position, const glm::vec3& scale) {
+		return glm::scale(glm::translate(glm::mat4(1.0f), position), scale);
+	}
+
+	// the tunnel and the two cubes of the demo scene
+	void addTunnelScene(OcclusionCuller& culler) {
+		culler.AddOccluderBox(unitCube, placed(glm::vec3(0.0f, 0.0f, 25.0f), glm::vec3(5.0f, 5.0f, 50.0f)));
+		culler.AddOccluderBox(unitCube, placed(glm::vec3(-1.0f, -2.0f, 10.0f), glm::vec3(1.0f)));
+		culler.AddOccluderBox(unitCube, placed(glm::vec3(0.0f, -2.0f, 5.0f), glm::vec3(1.0f)));
+	}
+}
+
+TEST(OcclusionAvx2DepthMatchesScalar) {
+	SimdLevel detected = ActiveSimdLevel();
+	if (detected != SimdLevel::AVX2) {
+		std::cout << "  no AVX2 on this CPU, skipped" << std::endl;
+		return;
+	}
+
+	const glm::vec3 eyes[] = { glm::vec3(0.0f, 0.0f, 1.0f), glm::vec3(1.5f, 1.0f, -8.0f), glm::vec3(-20.0f, 6.0f, 15.0f) };
+	const glm::vec3 targets[] = { glm::vec3(0.0f, 0.0f, 50.0f), glm::vec3(0.0f, -1.0f, 10.0f), glm::vec3(0.0f, 0.0f, 25.0f) };
+	for (int i = 0; i < 3; i++) {
+		// odd size, so the last eight-pixel step of a row is partly outside the triangle
+		OcclusionCuller scalar(203, 97, 8), avx2(203, 97, 8);
+		glm::mat4 vp = viewProjection(eyes[i], targets[i]);
+
+		ForceSimdLevel(SimdLevel::Scalar);
+		scalar.Begin(vp);
+		addTunnelScene(scalar);
+		scalar.Render();
+
+		ForceSimdLevel(SimdLevel::AVX2);
+		avx2.Begin(vp);
+		addTunnelScene(avx2);
+		avx2.Render();
+
+		CHECK(scalar.Depth().size() == avx2.Depth().size());
+		CHECK(std::memcmp(scalar.Depth().data(), avx2.Depth().data(), scalar.Depth().size() * sizeof(float)) == 0);
+
+		std::size_t covered = 0;
+		for (float d : avx2.Depth())
+			covered += d < 1.0f;
+		CHECK(covered > 0);
+	}
+	ForceSimdLevel(detected);
+}
+
+TEST(OcclusionWall) {
+	SimdLevel detected = ActiveSimdLevel();
+	for (SimdLevel level : { SimdLevel::Scalar, detected }) {
+		ForceSimdLevel(level);
+		OcclusionCuller culler;
+		culler.Begin(viewProjection(glm::vec3(0.0f), glm::vec3(0.0f, 0.0f, 1.0f)));
+		culler.AddOccluderBox({ glm::vec3(-1.0f, -1.0f, 5.0f), glm::vec3(1.0f, 1.0f, 6.0f) }, glm::mat4(1.0f));
+		culler.Render();
+
+		// behind the wall
+		CHECK(!culler.IsVisible({ glm::vec3(-0.5f, -0.5f, 10.0f), glm::vec3(0.5f, 0.5f, 11.0f) }));
+		// beside it, and partly peeking out from behind it
+		CHECK(culler.IsVisible({ glm::vec3(3.0f, -0.5f, 10.0f), glm::vec3(4.0f, 0.5f, 11.0f) }));
+		CHECK(culler.IsVisible({ glm::vec3(1.5f, -0.5f, 10.0f), glm::vec3(4.0f, 0.5f, 11.0f) }));
+		// in front of it
+		CHECK(culler.IsVisible({ glm::vec3(-0.5f, -0.5f, 2.0f), glm::vec3(0.5f, 0.5f, 3.0f) }));
+	}
+	ForceSimdLevel(detected);
+}
+
+TEST(OcclusionTunnel) {
+	SimdLevel detected = ActiveSimdLevel();
+	for (SimdLevel level : { SimdLevel::Scalar, detected }) {
+		ForceSimdLevel(level);
+		// inside the tunnel looking down it, the near end cap is clipped away
+		OcclusionCuller culler;
+		culler.Begin(viewProjection(glm::vec3(0.0f, 0.0f, 1.0f), glm::vec3(0.0f, 0.0f, 50.0f)));
+		culler.AddOccluderBox(unitCube, placed(glm::vec3(0.0f, 0.0f, 25.0f), glm::vec3(5.0f, 5.0f, 50.0f)));
+		culler.Render();
+
+		// inside, in front of the far end
+		CHECK(culler.IsVisible({ glm::vec3(-0.5f, 0.5f, 30.0f), glm::vec3(0.5f, 1.5f, 31.0f) }));
+		// beyond the far end
+		CHECK(!culler.IsVisible({ glm::vec3(-0.5f, -0.5f, 60.0f), glm::vec3(0.5f, 0.5f, 61.0f) }));
+		// outside the side walls
+		CHECK(!culler.IsVisible({ glm::vec3(8.0f, -0.5f, 20.0f), glm::vec3(9.0f, 0.5f, 21.0f) }));
+		// straddling the near plane
+		CHECK(culler.IsVisible({ glm::vec3(-0.5f, -0.5f, 0.0f), glm::vec3(0.5f, 0.5f, 1.05f) }));
+	}
+	ForceSimdLevel(detected);
+}
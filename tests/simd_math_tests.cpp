@@ -0,0 +1,157 @@
+#include "tests.h"
+
+#include "bounds.h"
+#include "simd_math.h"
+
+#include <cstring>
+#include <random>
+
+namespace {
+	const SimdLevel levels[] = { SimdLevel::Scalar, SimdLevel::SSE, SimdLevel::AVX2, SimdLevel::NEON };
+	const char* levelNames[] = { "scalar", "SSE", "AVX2", "NEON" };
+
+	// odd, so every batch path also runs its remainder
+	const std::size_t COUNT = 13;
+
+	template <typename T>
+	bool sameBits(const T& a, const T& b) {
+		return std::memcmp(&a, &b, sizeof(T)) == 0;
+	}
+
+	std::vector<glm::mat4> randomMatrices(std::mt19937& rng, std::size_t count) {
+		std::uniform_real_distribution<float> value(-4.0f, 4.0f);
+		std::vector<glm::mat4> matrices(count);
+		for (glm::mat4& m : matrices) {
+			for (int c = 0; c < 4; c++)
+				for (int r = 0; r < 4; r++)
+					m[c][r] = value(rng);
+		}
+		return matrices;
+	}
+
+	AABBArray randomBoxes(std::mt19937& rng, std::size_t count) {
+		std::uniform_real_distribution<float> position(-10.0f, 10.0f);
+		std::uniform_real_distribution<float> size(0.0f, 3.0f);
+		AABBArray boxes;
+		boxes.Resize(count);
+		for (std::size_t i = 0; i < count; i++) {
+			glm::vec3 min(position(rng), position(rng), position(rng));
+			boxes.Set(i, min, min + glm::vec3(size(rng), size(rng), size(rng)));
+		}
+		return boxes;
+	}
+
+	// runs check once per level the CPU has, then goes back to the detected one
+	template <typename Check>
+	void forEachLevel(Check check) {
+		SimdLevel detected = ActiveSimdLevel();
+		for (int i = 0; i < 4; i++) {
+			if (!ForceSimdLevel(levels[i]))
+				continue;
+			std::cout << "  " << levelNames[i] << std::endl;
+			check();
+		}
+		ForceSimdLevel(detected);
+	}
+}
+
+TEST(MulMat4MatchesGlm) {
+	std::mt19937 rng(1);
+	std::vector<glm::mat4> a = randomMatrices(rng, COUNT);
+	std::vector<glm::mat4> b = randomMatrices(rng, COUNT);
+
+	forEachLevel([&] {
+		for (std::size_t i = 0; i < COUNT; i++)
+			CHECK(sameBits(MulMat4(a[i], b[i]), a[i] * b[i]));
+
+		std::vector<glm::mat4> out(COUNT);
+		MulMat4(a, b, out);
+		for (std::size_t i = 0; i < COUNT; i++)
+			CHECK(sameBits(out[i], a[i] * b[i]));
+
+		MulMat4(a[0], b, out);
+		for (std::size_t i = 0; i < COUNT; i++)
+			CHECK(sameBits(out[i], a[0] * b[i]));
+	});
+}
+
+TEST(MulMat4AliasedOutput) {
+	std::mt19937 rng(2);
+	std::vector<glm::mat4> a = randomMatrices(rng, COUNT);
+	std::vector<glm::mat4> b = randomMatrices(rng, COUNT);
+
+	forEachLevel([&] {
+		glm::mat4 single = b[0];
+		single = MulMat4(a[0], single);
+		CHECK(sameBits(single, a[0] * b[0]));
+
+		// out over b
+		std::vector<glm::mat4> inPlace = b;
+		MulMat4(a, inPlace, inPlace);
+		for (std::size_t i = 0; i < COUNT; i++)
+			CHECK(sameBits(inPlace[i], a[i] * b[i]));
+
+		// out over a
+		inPlace = a;
+		MulMat4(inPlace, b, inPlace);
+		for (std::size_t i = 0; i < COUNT; i++)
+			CHECK(sameBits(inPlace[i], a[i] * b[i]));
+
+		// broadcast, out over b
+		inPlace = b;
+		MulMat4(a[0], inPlace, inPlace);
+		for (std::size_t i = 0; i < COUNT; i++)
+			CHECK(sameBits(inPlace[i], a[0] * b[i]));
+	});
+}
+
+TEST(NormalMatricesMatchGlm) {
+	std::mt19937 rng(3);
+	std::vector<glm::mat4> models = randomMatrices(rng, COUNT);
+
+	forEachLevel([&] {
+		std::vector<glm::mat3> out(COUNT);
+		NormalMatrices(models, out);
+		for (std::size_t i = 0; i < COUNT; i++)
+			CHECK(sameBits(out[i], glm::transpose(glm::inverse(glm::mat3(models[i])))));
+	});
+}
+
+TEST(TransformAABBsMatchesScalar) {
+	std::mt19937 rng(4);
+	AABBArray local = randomBoxes(rng, COUNT);
+	std::vector<glm::mat4> transforms = randomMatrices(rng, COUNT);
+
+	forEachLevel([&] {
+		AABBArray world;
+		TransformAABBs(local, transforms, world);
+		CHECK(world.Size() == COUNT);
+
+		// in place
+		AABBArray inPlace = local;
+		TransformAABBs(inPlace, transforms, inPlace);
+
+		for (std::size_t i = 0; i < COUNT; i++) {
+			AABB expected = AABB::Transform({ local.Min(i), local.Max(i) }, transforms[i]);
+			CHECK(sameBits(world.Min(i), expected.min));
+			CHECK(sameBits(world.Max(i), expected.max));
+			CHECK(sameBits(inPlace.Min(i), expected.min));
+			CHECK(sameBits(inPlace.Max(i), expected.max));
+		}
+	});
+}
+
+TEST(SphereOverlapsAABBsMatchesScalar) {
+	std::mt19937 rng(5);
+	AABBArray boxes = randomBoxes(rng, COUNT + 3);
+	glm::vec3 center(1.0f, -2.0f, 0.5f);
+	float radius = 6.0f;
+
+	forEachLevel([&] {
+		// from an offset that is not a multiple of any lane width
+		std::vector<uint8_t> hits(COUNT);
+		SphereOverlapsAABBs(boxes, 3, center, radius, hits);
+		for (std::size_t i = 0; i < COUNT; i++)
+			CHECK(hits[i] == (SphereOverlaps(center, radius, { boxes.Min(3 + i), boxes.Max(3 + i) }) ? 1 : 0));
+	});
+}
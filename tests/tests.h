@@ -0,0 +1,35 @@
+#ifndef TESTS_H
+#define TESTS_H
+
+#include <iostream>
+#include <vector>
+
+// minimal harness for the tests executable. TEST registers a function run by main,
+// CHECK reports a failed condition and carries on with the rest of the test.
+
+struct TestCase {
+    const char* name;
+    void (*run)();
+};
+
+std::vector<TestCase>& Tests();
+int& Failures();
+
+struct TestRegistration {
+    TestRegistration(const char* name, void (*run)()) { Tests().push_back({ name, run }); }
+};
+
+#define TEST(name) \
+    static void name(); \
+    static TestRegistration name##Registration(#name, name); \
+    static void name()
+
+#define CHECK(condition) \
+    do { \
+        if (!(condition)) { \
+            Failures()++; \
+            std::cout << "FAILED " << __FILE__ << ":" << __LINE__ << ": " << #condition << std::endl; \
+        } \
+    } while (0)
+
+#endif